@@ -0,0 +1,85 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+
+#include "libcron/DateTime.h"
+
+namespace libcron
+{
+// A point in civil time broken down into year, month, day, hour, minute and
+//  second, which may be changed directly while searching for an occurrence.
+// The day number of the first of the month is kept along with the fields, so
+//  that the day of week and the time_point of any day in the same month follow
+//  arithmetically; the date is only converted again once the year or month
+//  has changed.
+class CalendarCursor
+{
+public:
+  // 1970-01-01 00:00:00
+  CalendarCursor() = default;
+
+  // the given point in time, discarding fraction seconds
+  explicit CalendarCursor(std::chrono::system_clock::time_point time);
+
+  int      year   = 1970;
+  unsigned month  = 1;
+  unsigned day    = 1;
+  int      hour   = 0;
+  int      minute = 0;
+  int      second = 0;
+
+  // day of week of the given day of the current month, 0 being Sunday
+  unsigned weekday_of(unsigned d) const
+  {
+    const auto n = (day_number(d) + 4) % 7;  // 1970-01-01 was a Thursday
+    return static_cast<unsigned>(n < 0 ? n + 7 : n);
+  }
+
+  // day of week of the current day, 0 being Sunday
+  unsigned weekday() const { return weekday_of(day); }
+
+  unsigned days_in_month() const { return days_in_month(year, month); }
+
+  static unsigned days_in_month(int year, unsigned month)
+  {
+    constexpr unsigned char lengths[] = {
+      31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+    const bool leap = year % 4 == 0 && (year % 100 != 0 || year % 400 == 0);
+    return month == 2 && leap ? 29u : lengths[month - 1];
+  }
+
+  std::chrono::system_clock::time_point to_time_point() const
+  {
+    return std::chrono::system_clock::time_point{
+      std::chrono::seconds{day_number(day) * 86400 + hour * 3600 + minute * 60
+                           + second}};
+  }
+
+  DateTime to_date_time() const
+  {
+    return DateTime{year,
+                    month,
+                    day,
+                    static_cast<uint8_t>(hour),
+                    static_cast<uint8_t>(minute),
+                    static_cast<uint8_t>(second)};
+  }
+
+private:
+  // days since 1970-01-01 of the given day of the current month
+  int64_t day_number(unsigned d) const
+  {
+    if (year != start_year || month != start_month) { convert(); }
+    return month_start + d - 1;
+  }
+
+  // bring month_start up to date with year and month
+  void convert() const;
+
+  // the month for which month_start was last converted
+  mutable int      start_year  = 1970;
+  mutable unsigned start_month = 1;
+  mutable int64_t  month_start = 0;
+};
+}  // namespace libcron
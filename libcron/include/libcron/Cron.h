@@ -1,53 +1,173 @@
 #pragma once
 
 #include <chrono>
+#include <exception>
+#include <functional>
 #include <map>
+#include <optional>
 #include <stdexcept>
 #include <string>
+#include <string_view>
 #include <tuple>
+#include <utility>
+#include <vector>
 
 #include "libcron/CronClock.h"
+#include "libcron/CronExecutor.h"
 #include "libcron/CronLock.h"
 #include "libcron/Task.h"
 #include "libcron/TaskQueue.h"
+#include "libcron/TimeZone.h"
 
 namespace libcron
 {
 class Cron
 {
 public:
-  // allow specifying nothing, a lock, or a lock + clock
+  // allow specifying nothing, a lock, a lock + clock, a lock + clock +
+  //  the engine used to order tasks by their next schedule, or all of these
+  //  and the executor that runs the callbacks of expired tasks
   explicit Cron(
-    std::shared_ptr<ICronLock>  lock  = std::make_shared<NullLock>(),
-    std::shared_ptr<ICronClock> clock = std::make_shared<LocalClock>());
+    std::shared_ptr<ICronLock>     lock     = std::make_shared<NullLock>(),
+    std::shared_ptr<ICronClock>    clock    = std::make_shared<LocalClock>(),
+    QueueEngineType                engine   = QueueEngineType::BinaryHeap,
+    std::shared_ptr<ICronExecutor> executor =
+      std::make_shared<InlineExecutor>());
 
   // allow specifying only a clock
   explicit Cron(std::shared_ptr<ICronClock> clock);
 
+  // stops the thread started by start(), if any
+  ~Cron();
+
+  // an instance must not be moved while its thread is running; the
+  //  moved-from instance is left without tasks, sharing the lock, clock and
+  //  executor, and may be used again
+  Cron(Cron&& other);
+  Cron& operator=(Cron&& other);
+
   // schedule a callback task under the given name
   bool add_schedule(std::string        name,
                     const std::string& schedule,
                     Task::TaskFunction work);
 
+  // schedule a callback task under the given name, storing a handle to it in
+  //  the given handle; the handle is left empty if the schedule never expires
+  bool add_schedule(std::string        name,
+                    const std::string& schedule,
+                    Task::TaskFunction work,
+                    TaskHandle&        handle);
+
+  // schedule a callback task under the given name using an already parsed
+  //  schedule, such as one compiled with the _cron literal or
+  //  LIBCRON_CRON_EXPR()
+  void add_schedule(std::string        name,
+                    const CronData&    schedule,
+                    Task::TaskFunction work);
+
+  void add_schedule(std::string        name,
+                    const CronData&    schedule,
+                    Task::TaskFunction work,
+                    TaskHandle&        handle);
+
+  // schedule a callback task under the given name, matching the schedule
+  //  against the civil time of the given time zone; next schedules of such
+  //  tasks are in UTC, so the Cron instance should use a UTCClock
+  // returns false if the schedule is invalid or there is no time zone
+  bool add_schedule(std::string                     name,
+                    const std::string&              schedule,
+                    std::shared_ptr<const TimeZone> zone,
+                    Task::TaskFunction              work);
+
+  bool add_schedule(std::string                     name,
+                    const std::string&              schedule,
+                    std::shared_ptr<const TimeZone> zone,
+                    Task::TaskFunction              work,
+                    TaskHandle&                     handle);
+
   template<typename Schedules = std::map<std::string, std::string>>
   std::tuple<bool, std::string, std::string> add_schedule(
     const Schedules& name_schedule_map, Task::TaskFunction work);
 
+  // change the schedule of the task scheduled under the given name, keeping
+  //  its callback; a task whose new schedule never expires is removed
+  // returns false if the schedule is invalid or there is no such task
+  bool reschedule(std::string_view name, const std::string& schedule);
+
+  // set how the task scheduled under the given name is handled when it
+  //  expires while its callback is still running on another thread; tasks
+  //  start out with OverlapPolicy::Allow
+  // returns false if there is no such task
+  bool set_overlap_policy(std::string_view name, OverlapPolicy policy);
+
+  // set the execution key of the task scheduled under the given name; an
+  //  executor such as KeyedExecutor runs tasks sharing a key one at a time
+  // returns false if there is no such task
+  bool set_execution_key(std::string_view name, std::string key);
+
   // clear scheduled task list
   void clear_schedules();
 
   // remove task that was scheduled under the given name
-  void remove_schedule(const std::string& name);
+  void remove_schedule(std::string_view name);
+
+  // remove the task the handle refers to, returning whether it was scheduled
+  bool remove_schedule(TaskHandle handle);
+
+  // return whether the task the handle refers to is still scheduled
+  bool is_scheduled(TaskHandle handle) const;
+
+  // returns time until the next execution of the task the handle refers to,
+  //  or nothing if it is no longer scheduled
+  std::optional<std::chrono::system_clock::duration> time_until_expiry(
+    TaskHandle handle) const;
 
   // return task count
   size_t count() const;
 
   // Tick is expected to be called at least once a second to prevent missing
   // schedules.
+  // Expired tasks are handed to the executor, which runs their callbacks
+  //  right away or later on other threads, unless held back by their overlap
+  //  policy; returns the number of expired tasks.
   size_t tick();
 
   size_t tick(std::chrono::system_clock::time_point now);
 
+  // start a thread that calls tick() whenever a task is due and sleeps in
+  //  between, instead of tick() being called in a loop
+  // the thread is woken early when tasks are added, rescheduled or removed,
+  //  and when the system clock is set forward; a clock set back is noticed
+  //  within a minute
+  // calls from other threads then need a Locker, as with calling tick() from
+  //  another thread
+  // an exception thrown by a callback run on the thread, as by the
+  //  InlineExecutor, is passed to on_error, or dropped if there is none; the
+  //  other expired tasks still run, and on_error must not throw
+  // returns false if the thread is already running
+  // this method is NOT thread safe with respect to stop()
+  bool start(std::function<void(std::exception_ptr)> on_error = nullptr);
+
+  // stop the thread started by start(), waiting for a tick in progress
+  // must not be called from a callback running on that thread
+  // this method is NOT thread safe with respect to start()
+  void stop();
+
+  // return whether the thread started by start() is running
+  bool is_running() const;
+
+  // return a file descriptor that becomes readable when a task is due, to
+  //  wait on with epoll, poll or select and call tick() whenever it is
+  //  readable, instead of calling tick() in a loop
+  // the descriptor is a timerfd owned by the instance, armed for the next due
+  //  task and armed again by tick() and whenever tasks are added,
+  //  rescheduled or removed; it also becomes readable when the system clock
+  //  is set
+  // returns -1 if the timer cannot be created, and on systems other than
+  //  Linux
+  // this method IS thread safe when using the Locker
+  int get_timer_fd();
+
   // returns time until next scheduled task execution, or
   //  std::numeric_limits<std::chrono::minutes>::max() if no tasks
   //  are currently scheduled
@@ -67,14 +187,69 @@ public:
     std::vector<std::tuple<std::string, std::chrono::system_clock::duration>>&
       status) const;
 
+  // return the total number of times the scheduled tasks run at or after
+  //  from and before until, counted once per distinct schedule without
+  //  enumerating occurrences
+  uint64_t count_occurrences(std::chrono::system_clock::time_point from,
+                             std::chrono::system_clock::time_point until) const;
+
+  // return the scheduled task names and the number of times each runs at or
+  //  after from and before until, ordered by their next schedule
+  void get_occurrence_counts_for_tasks(
+    std::chrono::system_clock::time_point           from,
+    std::chrono::system_clock::time_point           until,
+    std::vector<std::tuple<std::string, uint64_t>>& counts) const;
+
   friend std::ostream& operator<<(std::ostream& stream, const Cron& c);
 
 private:
+  struct Runner;
+
+  // body of the thread started by start()
+  void run();
+
+  // tick, passing exceptions thrown while handing over expired tasks to
+  //  on_error instead of letting them escape, if on_error is given
+  size_t tick(std::chrono::system_clock::time_point              now,
+              const std::function<void(std::exception_ptr)>* on_error);
+
+  // how long the thread started by start() may sleep before the next tick
+  std::chrono::system_clock::duration time_until_tick() const;
+
+  // how long until tick() has work, or duration::max() if there are no tasks
+  // the queue must be locked
+  std::chrono::system_clock::duration time_until_work(
+    std::chrono::system_clock::time_point now) const;
+
+  // arm the timer of get_timer_fd(), if created, for the next tick that has
+  //  work, and clear its readiness; the queue must be locked
+  void arm_timer();
+
+  // consume the expiry of the timer of get_timer_fd(), if created
+  void drain_timer();
+
+  // wake the thread started by start() to look at the changed tasks
+  void notify_schedule_changed();
+
+  void add_task(std::string                     name,
+                const CronData&                 schedule,
+                std::shared_ptr<const TimeZone> zone,
+                Task::TaskFunction              work,
+                TaskHandle&                     handle);
+
+  // occurrence counts by schedule and time zone, each counted once
+  std::map<std::pair<const CronSchedule*, const TimeZone*>, uint64_t>
+  count_by_schedule(
+    std::chrono::system_clock::time_point from,
+    std::chrono::system_clock::time_point until) const;
+
   std::shared_ptr<ICronLock>            lockSptr;
   std::shared_ptr<ICronClock>           clockSptr;
-  TaskQueue                             tasks{lockSptr};
+  std::shared_ptr<ICronExecutor>        executorSptr;
+  TaskQueue                             tasks;
   bool                                  first_tick = true;
   std::chrono::system_clock::time_point last_tick{};
+  std::unique_ptr<Runner>               runner;
 };
 
 template<typename Schedules>
@@ -87,10 +262,9 @@ std::tuple<bool, std::string, std::string> Cron::add_schedule(
   std::vector<Task> tasks_to_add;
   tasks_to_add.reserve(name_schedule_map.size());
 
-  for (auto it : name_schedule_map)
+  for (const auto& [name, schedule] : name_schedule_map)
   {
-    const auto& [name, schedule] = *it;
-    auto cron                    = CronData::create(schedule);
+    auto cron = CronData::create(schedule);
     if (!cron)
     {
       is_valid = false;
@@ -99,20 +273,20 @@ std::tuple<bool, std::string, std::string> Cron::add_schedule(
       break;
     }
 
-    Task t{std::move(name), CronSchedule{*cron}, work};
+    Task t{name, CronSchedule::intern(*cron), work};
     if (t.calculate_next(clockSptr->now()))
     {
       tasks_to_add.push_back(std::move(t));
     }
   }
 
-  // Only add tasks and sort once if all elements in the map where valid
+  // Only add tasks if all elements in the map where valid
   if (is_valid && !tasks_to_add.empty())
   {
     tasks.lock_queue();
     tasks.push(tasks_to_add);
-    tasks.sort();
     tasks.release_queue();
+    notify_schedule_changed();
   }
 
   std::get<0>(res) = is_valid;
@@ -1,6 +1,8 @@
 #pragma once
 
+#include <atomic>
 #include <chrono>
+#include <cstdint>
 
 namespace libcron
 {
@@ -21,12 +23,59 @@ public:
     std::chrono::system_clock::time_point) const override;
 };
 
+// UTC read from a coarse clock source, CLOCK_REALTIME_COARSE on Linux, which
+//  is cheaper to read than system_clock but only advances every few
+//  milliseconds. Falls back to system_clock elsewhere.
+class CoarseUTCClock : public UTCClock
+{
+public:
+  std::chrono::system_clock::time_point now() const override;
+};
+
+// Local time, derived from UTC by the offset of the system time zone.
+// The offset is cached together with the window it is valid for, which ends
+//  at the next change of the offset (such as a DST transition) or after at
+//  most a day. Within that window now() and utc_offset() only read the clock
+//  and the cache, without calling into the C library.
+// All methods are thread safe. Copies start out with the cache of the
+//  original.
 class LocalClock : public ICronClock
 {
 public:
+  LocalClock() = default;
+
+  LocalClock(const LocalClock& other);
+  LocalClock& operator=(const LocalClock& other);
+
   std::chrono::system_clock::time_point now() const override;
 
   std::chrono::seconds utc_offset(
     std::chrono::system_clock::time_point now) const override;
+
+private:
+  // the offset of the system time zone at the given time, uncached
+  static std::chrono::seconds calculate_utc_offset(
+    std::chrono::system_clock::time_point time);
+
+  // calculate and cache the offset at the given time and its window
+  std::chrono::seconds update_cache(
+    std::chrono::system_clock::time_point time) const;
+
+  // store a window and its offset in the cache, unless another update is in
+  //  progress
+  void store_cache(int64_t from, int64_t until, int64_t offset) const;
+
+  // the cache is a seqlock: sequence is odd while an update is in progress
+  mutable std::atomic<uint32_t> sequence{0};
+  mutable std::atomic<int64_t>  valid_from{0};
+  mutable std::atomic<int64_t>  valid_until{0};
+  mutable std::atomic<int64_t>  cached_offset{0};
+};
+
+// Local time read from the same coarse clock source as CoarseUTCClock
+class CoarseLocalClock : public LocalClock
+{
+public:
+  std::chrono::system_clock::time_point now() const override;
 };
 }  // namespace libcron
@@ -1,54 +1,181 @@
 #pragma once
 
+#include <algorithm>
+#include <array>
+#include <cctype>
 #include <optional>
 #include <regex>
-#include <set>
+#include <stdexcept>
 #include <string>
-#include <unordered_map>
+#include <string_view>
+#include <utility>
 #include <vector>
 
+#include "libcron/CronField.h"
 #include "libcron/TimeTypes.h"
 
 namespace libcron
 {
-class CronData
+class CronDataCache;
+
+namespace detail
+{
+// Fixed capacity text buffer usable in constant expressions. Modifications
+// that would exceed the capacity fail and leave the buffer unchanged.
+template<size_t N>
+class FixedString
+{
+public:
+  constexpr bool assign(std::string_view s)
+  {
+    if (s.size() > N) { return false; }
+
+    for (size_t i = 0; i < s.size(); ++i) { chars[i] = s[i]; }
+    length = s.size();
+
+    return true;
+  }
+
+  constexpr bool replace(size_t pos, size_t count, std::string_view with)
+  {
+    const auto new_length = length - count + with.size();
+    if (new_length > N) { return false; }
+
+    // Move the tail into place, then copy the replacement
+    if (with.size() > count)
+    {
+      for (auto i = length; i-- > pos + count;)
+      {
+        chars[i + with.size() - count] = chars[i];
+      }
+    }
+    else
+    {
+      for (auto i = pos + count; i < length; ++i)
+      {
+        chars[i - (count - with.size())] = chars[i];
+      }
+    }
+
+    for (size_t i = 0; i < with.size(); ++i) { chars[pos + i] = with[i]; }
+    length = new_length;
+
+    return true;
+  }
+
+  constexpr std::string_view view() const { return {chars.data(), length}; }
+
+private:
+  std::array<char, N> chars{};
+  size_t              length = 0;
+};
+
+// The same interface on top of std::string, for text of any length
+class DynamicString
 {
 public:
-  static constexpr int         NUMBER_OF_LONG_MONTHS = 7;
-  static const libcron::Months months_with_31[NUMBER_OF_LONG_MONTHS];
+  bool assign(std::string_view s)
+  {
+    text.assign(s.data(), s.size());
+    return true;
+  }
+
+  bool replace(size_t pos, size_t count, std::string_view with)
+  {
+    text.replace(pos, count, with.data(), with.size());
+    return true;
+  }
+
+  std::string_view view() const { return text; }
 
-  static std::optional<CronData> create(const std::string& cron_expression);
+private:
+  std::string text;
+};
+}  // namespace detail
+
+class CronData
+{
+public:
+  static constexpr int             NUMBER_OF_LONG_MONTHS = 7;
+  static constexpr libcron::Months months_with_31[NUMBER_OF_LONG_MONTHS] = {
+    Months::January,
+    Months::March,
+    Months::May,
+    Months::July,
+    Months::August,
+    Months::October,
+    Months::December};
+
+  // Longest text create_constexpr() can handle after expanding convenience
+  // macros, and longest comma separated part containing names
+  static constexpr size_t max_constexpr_length = 256;
+
+  // parse the expression, consulting the shared cache() first
+  static std::optional<CronData> create(std::string_view cron_expression);
+
+  // parse the expression without consulting or filling the cache
+  static std::optional<CronData> create_uncached(
+    std::string_view cron_expression);
+
+  // the cache shared by all create() calls
+  static CronDataCache& cache();
+
+  // parse the expression with the same rules as create(), in a constant
+  // expression if so desired; see also the _cron literal and
+  // LIBCRON_CRON_EXPR() below
+  static constexpr std::optional<CronData> create_constexpr(
+    std::string_view cron_expression);
+
+  // Reference implementation of create() based on std::regex. It is much
+  // slower, bypasses the cache and is only kept to verify the hand-written
+  // parser against.
+  static std::optional<CronData> create_using_regex(
+    const std::string& cron_expression);
 
   CronData(const CronData&) = default;
 
-  const std::set<Seconds>& get_seconds() const { return seconds; }
+  constexpr const CronField<Seconds>& get_seconds() const { return seconds; }
 
-  const std::set<Minutes>& get_minutes() const { return minutes; }
+  constexpr const CronField<Minutes>& get_minutes() const { return minutes; }
 
-  const std::set<Hours>& get_hours() const { return hours; }
+  constexpr const CronField<Hours>& get_hours() const { return hours; }
 
-  const std::set<DayOfMonth>& get_day_of_month() const { return day_of_month; }
+  constexpr const CronField<DayOfMonth>& get_day_of_month() const
+  {
+    return day_of_month;
+  }
 
-  const std::set<Months>& get_months() const { return months; }
+  constexpr const CronField<Months>& get_months() const { return months; }
 
-  const std::set<DayOfWeek>& get_day_of_week() const { return day_of_week; }
+  constexpr const CronField<DayOfWeek>& get_day_of_week() const
+  {
+    return day_of_week;
+  }
+
+  // Two expressions are equal when they select the same values, regardless
+  // of how they were written
+  bool operator==(const CronData& other) const;
+
+  bool operator!=(const CronData& other) const { return !(*this == other); }
+
+  size_t hash() const;
 
   template<typename T>
-  static uint8_t value_of(T t)
+  static constexpr uint8_t value_of(T t)
   {
     return static_cast<uint8_t>(t);
   }
 
   template<typename T>
-  static bool has_any_in_range(const std::set<T>& set,
-                               uint8_t            low,
-                               uint8_t            high)
+  static constexpr bool has_any_in_range(const CronField<T>& set,
+                                         uint8_t             low,
+                                         uint8_t             high)
   {
     bool found = false;
 
     for (auto i = low; !found && i <= high; ++i)
     {
-      found |= set.find(static_cast<T>(i)) != set.end();
+      found |= set.contains(static_cast<T>(i));
     }
 
     return found;
@@ -56,33 +183,70 @@ public:
 
   template<typename T>
   static bool convert_from_string_range_to_number_range(
-    const std::string& range, std::set<T>& numbers);
+    const std::string& range, CronField<T>& numbers);
 
   template<typename T>
   static std::string& replace_string_name_with_numeric(std::string& s);
 
 private:
-  CronData() = delete;
+  CronData() = default;
+
+  bool parse(std::string_view cron_expression);
+
+  // Buffer is detail::FixedString or detail::DynamicString, holding the
+  // expression once macros are expanded and parts once names are replaced
+  template<typename Buffer>
+  constexpr bool parse(std::string_view cron_expression,
+                       Buffer&          expanded,
+                       Buffer&          part_buffer);
+
+  bool parse_using_regex(const std::string& cron_expression);
 
-  CronData(const std::string& cron_expression);
+  template<typename Buffer>
+  static constexpr bool expand_macros(std::string_view cron_expression,
+                                      Buffer&          expression);
+
+  static constexpr bool split_fields(std::string_view                 expression,
+                                     std::array<std::string_view, 6>& fields);
+
+  template<typename T, typename Buffer>
+  static constexpr bool parse_field(std::string_view field,
+                                    CronField<T>&    numbers,
+                                    Buffer&          buffer);
 
   template<typename T>
-  bool validate_numeric(const std::string& s, std::set<T>& numbers);
+  static constexpr bool parse_part(std::string_view part,
+                                   CronField<T>&    numbers);
+
+  template<typename Buffer, size_t N>
+  static constexpr bool replace_names(
+    Buffer&                                   s,
+    const std::array<std::string_view, N>& names,
+    int                                       value_of_first_name);
+
+  static constexpr bool parse_number(std::string_view s, int32_t& value);
 
   template<typename T>
-  bool validate_literal(const std::string&              s,
-                        std::set<T>&                    numbers,
-                        const std::vector<std::string>& names);
+  static bool convert_from_string_range_to_number_range_using_regex(
+    const std::string& range, CronField<T>& numbers);
+
+  template<typename T>
+  bool validate_numeric(const std::string& s, CronField<T>& numbers);
+
+  template<typename T, size_t N>
+  bool validate_literal(const std::string&                     s,
+                        CronField<T>&                          numbers,
+                        const std::array<std::string_view, N>& names);
 
   template<typename T>
   bool process_parts(const std::vector<std::string>& parts,
-                     std::set<T>&                    numbers);
+                     CronField<T>&                   numbers);
 
   template<typename T>
-  static bool add_number(std::set<T>& set, int32_t number);
+  static constexpr bool add_number(CronField<T>& set, int32_t number);
 
   template<typename T>
-  static bool is_within_limits(int32_t low, int32_t high);
+  static constexpr bool is_within_limits(int32_t low, int32_t high);
 
   template<typename T>
   static bool get_range(const std::string& s, T& low, T& high);
@@ -94,39 +258,58 @@ private:
 
   static bool is_number(const std::string& s);
 
-  static bool is_between(int32_t value, int32_t low_limit, int32_t high_limit);
+  static constexpr bool is_between(int32_t value,
+                                   int32_t low_limit,
+                                   int32_t high_limit);
+
+  constexpr bool validate_date_vs_months() const;
+
+  constexpr bool check_dom_vs_dow(std::string_view dom,
+                                  std::string_view dow) const;
+
+  CronField<Seconds>    seconds{};
+  CronField<Minutes>    minutes{};
+  CronField<Hours>      hours{};
+  CronField<DayOfMonth> day_of_month{};
+  CronField<Months>     months{};
+  CronField<DayOfWeek>  day_of_week{};
+
+  static constexpr std::array<std::string_view, 12> month_names{"JAN",
+                                                               "FEB",
+                                                               "MAR",
+                                                               "APR",
+                                                               "MAY",
+                                                               "JUN",
+                                                               "JUL",
+                                                               "AUG",
+                                                               "SEP",
+                                                               "OCT",
+                                                               "NOV",
+                                                               "DEC"};
+  static constexpr std::array<std::string_view, 7> day_names{
+    "SUN", "MON", "TUE", "WED", "THU", "FRI", "SAT"};
 
-  bool validate_date_vs_months() const;
-
-  bool check_dom_vs_dow(const std::string& dom, const std::string& dow) const;
-
-  std::set<Seconds>    seconds{};
-  std::set<Minutes>    minutes{};
-  std::set<Hours>      hours{};
-  std::set<DayOfMonth> day_of_month{};
-  std::set<Months>     months{};
-  std::set<DayOfWeek>  day_of_week{};
-
-  static const std::vector<std::string>            month_names;
-  static const std::vector<std::string>            day_names;
-  static std::unordered_map<std::string, CronData> cache;
+  template<typename T>
+  static constexpr void add_full_range(CronField<T>& set);
 
   template<typename T>
-  static void add_full_range(std::set<T>& set);
+  static constexpr void add_range(CronField<T>& set,
+                                  int32_t       left,
+                                  int32_t       right);
 };
 
 template<typename T>
-bool CronData::validate_numeric(const std::string& s, std::set<T>& numbers)
+bool CronData::validate_numeric(const std::string& s, CronField<T>& numbers)
 {
   std::vector<std::string> parts = split(s, ',');
 
   return process_parts(parts, numbers);
 }
 
-template<typename T>
-bool CronData::validate_literal(const std::string&              s,
-                                std::set<T>&                    numbers,
-                                const std::vector<std::string>& names)
+template<typename T, size_t N>
+bool CronData::validate_literal(const std::string&                     s,
+                                CronField<T>&                          numbers,
+                                const std::array<std::string_view, N>& names)
 {
   std::vector<std::string> parts = split(s, ',');
 
@@ -135,8 +318,9 @@ bool CronData::validate_literal(const std::string&              s,
   // Replace each found name with the corresponding value.
   for (const auto& name : names)
   {
-    std::regex m(
-      name, std::regex_constants::ECMAScript | std::regex_constants::icase);
+    std::regex m(std::string{name},
+                 std::regex_constants::ECMAScript
+                   | std::regex_constants::icase);
 
     for (auto& part : parts)
     {
@@ -158,13 +342,120 @@ bool CronData::validate_literal(const std::string&              s,
 
 template<typename T>
 bool CronData::process_parts(const std::vector<std::string>& parts,
-                             std::set<T>&                    numbers)
+                             CronField<T>&                   numbers)
 {
   bool res = true;
 
   for (const auto& p : parts)
   {
-    res &= convert_from_string_range_to_number_range(p, numbers);
+    res &= convert_from_string_range_to_number_range_using_regex(p, numbers);
+  }
+
+  return res;
+}
+
+template<typename T, typename Buffer>
+constexpr bool CronData::parse_field(std::string_view field,
+                                     CronField<T>&    numbers,
+                                     Buffer&          buffer)
+{
+  size_t start = 0;
+
+  for (;;)
+  {
+    const auto comma = field.find(',', start);
+    auto       part  = field.substr(
+      start, comma == std::string_view::npos ? comma : comma - start);
+
+    // Like std::sregex_token_iterator, ignore an empty part after the last
+    // separator.
+    if (comma == std::string_view::npos && part.empty() && start > 0)
+    {
+      break;
+    }
+
+    if constexpr (std::is_same<T, libcron::Months>() ||
+                  std::is_same<T, libcron::DayOfWeek>())
+    {
+      bool has_letters = false;
+      for (auto c : part)
+      {
+        has_letters |= (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z');
+      }
+
+      if (has_letters)
+      {
+        bool replaced = buffer.assign(part);
+
+        if constexpr (std::is_same<T, libcron::Months>())
+        {
+          replaced = replaced
+                     && replace_names(buffer, month_names, value_of(T::First));
+        }
+        else
+        {
+          replaced = replaced
+                     && replace_names(buffer, day_names, value_of(T::First));
+        }
+
+        if (!replaced) { return false; }
+        part = buffer.view();
+      }
+    }
+
+    if (!parse_part<T>(part, numbers)) { return false; }
+
+    if (comma == std::string_view::npos) { break; }
+
+    start = comma + 1;
+  }
+
+  return true;
+}
+
+template<typename T>
+constexpr bool CronData::parse_part(std::string_view part,
+                                    CronField<T>&    numbers)
+{
+  bool    res   = true;
+  int32_t left  = 0;
+  int32_t right = 0;
+
+  const auto separator = part.find_first_of("-/");
+
+  if (part == "*" || part == "?")
+  {
+    // We treat the ignore-character '?' the same as the full range being
+    // allowed.
+    add_full_range<T>(numbers);
+  }
+  else if (separator == std::string_view::npos)
+  {
+    res = parse_number(part, left) && add_number<T>(numbers, left);
+  }
+  else if (part[separator] == '-')
+  {
+    res = parse_number(part.substr(0, separator), left) &&
+          parse_number(part.substr(separator + 1), right) &&
+          is_within_limits<T>(left, right);
+
+    if (res) { add_range<T>(numbers, left, right); }
+  }
+  else
+  {
+    const auto start = part.substr(0, separator);
+
+    if (start == "*") { left = value_of(T::First); }
+    else { res = parse_number(start, left); }
+
+    res = res && parse_number(part.substr(separator + 1), right) &&
+          is_within_limits<T>(left, left) && right > 0;
+
+    // Add from left to T::Last with a step of 'right'
+    for (auto v = left; res && v <= value_of(T::Last); v += right)
+    {
+      add_number<T>(numbers, v);
+    }
   }
 
   return res;
@@ -229,38 +520,49 @@ bool CronData::get_step(const std::string& s, uint8_t& start, uint8_t& step)
 }
 
 template<typename T>
-void CronData::add_full_range(std::set<T>& set)
+constexpr void CronData::add_full_range(CronField<T>& set)
 {
   for (auto v = value_of(T::First); v <= value_of(T::Last); ++v)
   {
-    if (set.find(static_cast<T>(v)) == set.end())
-    {
-      set.emplace(static_cast<T>(v));
-    }
+    set.insert(static_cast<T>(v));
   }
 }
 
 template<typename T>
-bool CronData::add_number(std::set<T>& set, int32_t number)
+constexpr void CronData::add_range(CronField<T>& set,
+                                   int32_t       left,
+                                   int32_t       right)
 {
-  bool res = true;
-
-  // Don't add if already there
-  if (set.find(static_cast<T>(number)) == set.end())
+  // A range can be written as both 1-22 or 22-1, meaning totally different
+  // ranges. First case is 1...22 while 22-1 is only four hours: 22, 23, 0, 1.
+  if (left <= right)
   {
-    // Check range
-    if (is_within_limits<T>(number, number))
-    {
-      set.emplace(static_cast<T>(number));
-    }
-    else { res = false; }
+    for (auto v = left; v <= right; ++v) { add_number(set, v); }
   }
+  else
+  {
+    // 'left' and 'right' are not in value order. First, get values between
+    // 'left' and T::Last, inclusive
+    for (auto v = left; v <= value_of(T::Last); ++v) { add_number(set, v); }
+
+    // Next, get values between T::First and 'right', inclusive.
+    for (auto v = value_of(T::First); v <= right; ++v) { add_number(set, v); }
+  }
+}
+
+template<typename T>
+constexpr bool CronData::add_number(CronField<T>& set, int32_t number)
+{
+  // Check range before touching the bitmask
+  bool res = is_within_limits<T>(number, number);
+
+  if (res) { set.insert(static_cast<T>(number)); }
 
   return res;
 }
 
 template<typename T>
-bool CronData::is_within_limits(int32_t low, int32_t high)
+constexpr bool CronData::is_within_limits(int32_t low, int32_t high)
 {
   return is_between(low, value_of(T::First), value_of(T::Last)) &&
          is_between(high, value_of(T::First), value_of(T::Last));
@@ -268,7 +570,14 @@ bool CronData::is_within_limits(int32_t low, int32_t high)
 
 template<typename T>
 bool CronData::convert_from_string_range_to_number_range(
-  const std::string& range, std::set<T>& numbers)
+  const std::string& range, CronField<T>& numbers)
+{
+  return parse_part<T>(range, numbers);
+}
+
+template<typename T>
+bool CronData::convert_from_string_range_to_number_range_using_regex(
+  const std::string& range, CronField<T>& numbers)
 {
   T       left;
   T       right;
@@ -286,30 +595,7 @@ bool CronData::convert_from_string_range_to_number_range(
   else if (is_number(range)) { res = add_number<T>(numbers, std::stoi(range)); }
   else if (get_range<T>(range, left, right))
   {
-    // A range can be written as both 1-22 or 22-1, meaning totally different
-    // ranges. First case is 1...22 while 22-1 is only four hours: 22, 23, 0, 1.
-    if (left <= right)
-    {
-      for (auto v = value_of(left); v <= value_of(right); ++v)
-      {
-        res &= add_number(numbers, v);
-      }
-    }
-    else
-    {
-      // 'left' and 'right' are not in value order. First, get values between
-      // 'left' and T::Last, inclusive
-      for (auto v = value_of(left); v <= value_of(T::Last); ++v)
-      {
-        res = add_number(numbers, v);
-      }
-
-      // Next, get values between T::First and 'right', inclusive.
-      for (auto v = value_of(T::First); v <= value_of(right); ++v)
-      {
-        res = add_number(numbers, v);
-      }
-    }
+    add_range<T>(numbers, value_of(left), value_of(right));
   }
   else if (get_step<T>(range, step_start, step))
   {
@@ -327,38 +613,268 @@ bool CronData::convert_from_string_range_to_number_range(
 template<typename T>
 std::string& CronData::replace_string_name_with_numeric(std::string& s)
 {
-  auto value = static_cast<int>(T::First);
-
-  const std::vector<std::string>* name_source{};
-
   static_assert(
     std::is_same<T, libcron::Months>() || std::is_same<T, libcron::DayOfWeek>(),
     "T must be either Months or DayOfWeek");
 
+  detail::DynamicString buffer;
+  buffer.assign(s);
+
   if constexpr (std::is_same<T, libcron::Months>())
   {
-    name_source = &month_names;
+    replace_names(buffer, month_names, value_of(T::First));
+  }
+  else { replace_names(buffer, day_names, value_of(T::First)); }
+
+  s.assign(buffer.view().data(), buffer.view().size());
+
+  return s;
+}
+
+constexpr std::optional<CronData> CronData::create_constexpr(
+  std::string_view cron_expression)
+{
+  CronData                                   c;
+  detail::FixedString<max_constexpr_length> expanded;
+  detail::FixedString<max_constexpr_length> part_buffer;
+
+  if (!c.parse(cron_expression, expanded, part_buffer)) { return {}; }
+
+  return c;
+}
+
+template<typename Buffer>
+constexpr bool CronData::parse(std::string_view cron_expression,
+                               Buffer&          expanded,
+                               Buffer&          part_buffer)
+{
+  // Only pay for a copy when there is a convenience macro to expand.
+  if (cron_expression.find('@') != std::string_view::npos)
+  {
+    if (!expand_macros(cron_expression, expanded)) { return false; }
+    cron_expression = expanded.view();
   }
-  else { name_source = &day_names; }
 
-  for (const auto& name : *name_source)
+  std::array<std::string_view, 6> fields{};
+
+  return split_fields(cron_expression, fields) &&
+         parse_field<Seconds>(fields[0], seconds, part_buffer) &&
+         parse_field<Minutes>(fields[1], minutes, part_buffer) &&
+         parse_field<Hours>(fields[2], hours, part_buffer) &&
+         parse_field<DayOfMonth>(fields[3], day_of_month, part_buffer) &&
+         parse_field<Months>(fields[4], months, part_buffer) &&
+         parse_field<DayOfWeek>(fields[5], day_of_week, part_buffer) &&
+         check_dom_vs_dow(fields[3], fields[5]) && validate_date_vs_months();
+}
+
+template<typename Buffer>
+constexpr bool CronData::expand_macros(std::string_view cron_expression,
+                                       Buffer&          expression)
+{
+  constexpr std::pair<std::string_view, std::string_view> macros[] = {
+    {"@yearly", "0 0 1 1 *"},
+    {"@annually", "0 0 1 1 *"},
+    {"@monthly", "0 0 1 * *"},
+    {"@weekly", "0 0 * * 0"},
+    {"@daily", "0 0 * * *"},
+    {"@hourly", "0 * * * *"}};
+
+  if (!expression.assign(cron_expression)) { return false; }
+
+  // Same semantics as the sequence of std::regex_replace() calls in
+  // parse_using_regex(): each macro in turn, all occurrences.
+  for (const auto& macro : macros)
   {
-    std::regex m(
-      name, std::regex_constants::ECMAScript | std::regex_constants::icase);
+    for (auto pos = expression.view().find(macro.first);
+         pos != std::string_view::npos;
+         pos = expression.view().find(macro.first, pos + macro.second.size()))
+    {
+      if (!expression.replace(pos, macro.first.size(), macro.second))
+      {
+        return false;
+      }
+    }
+  }
+
+  return true;
+}
 
-    std::string replaced;
+constexpr bool CronData::split_fields(std::string_view                 expression,
+                                      std::array<std::string_view, 6>& fields)
+{
+  // Same white-space characters as \s in the regex path
+  auto is_space = [](char c)
+  {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\v' || c == '\f' ||
+           c == '\r';
+  };
 
-    std::regex_replace(std::back_inserter(replaced),
-                       s.begin(),
-                       s.end(),
-                       m,
-                       std::to_string(value));
+  size_t count = 0;
+  size_t pos   = 0;
+
+  while (pos < expression.size())
+  {
+    while (pos < expression.size() && is_space(expression[pos])) { ++pos; }
 
-    s = replaced;
+    if (pos == expression.size()) { break; }
 
-    ++value;
+    const auto start = pos;
+    while (pos < expression.size() && !is_space(expression[pos])) { ++pos; }
+
+    // Any additional field makes the expression invalid
+    if (count == fields.size()) { return false; }
+
+    fields[count++] = expression.substr(start, pos - start);
   }
 
-  return s;
+  return count == fields.size();
 }
+
+template<typename Buffer, size_t N>
+constexpr bool CronData::replace_names(
+  Buffer&                                   s,
+  const std::array<std::string_view, N>& names,
+  int                                       value_of_first_name)
+{
+  auto to_upper = [](char c) -> char
+  { return (c >= 'a' && c <= 'z') ? static_cast<char>(c - 'a' + 'A') : c; };
+
+  // First position >= from where name occurs, ignoring case
+  auto find = [&s, &to_upper](std::string_view name, size_t from)
+  {
+    const auto text = s.view();
+
+    for (auto pos = from; pos + name.size() <= text.size(); ++pos)
+    {
+      bool match = true;
+      for (size_t i = 0; match && i < name.size(); ++i)
+      {
+        match = to_upper(text[pos + i]) == to_upper(name[i]);
+      }
+
+      if (match) { return pos; }
+    }
+
+    return std::string_view::npos;
+  };
+
+  // Replace each found name with the corresponding value, in the order of the
+  // names; earlier replacements may thus form part of later matches.
+  for (const auto& name : names)
+  {
+    // Values are at most two digits
+    const auto value = value_of_first_name++;
+    const char digits[2] = {static_cast<char>('0' + value / 10),
+                            static_cast<char>('0' + value % 10)};
+    const auto replacement =
+      value < 10 ? std::string_view{digits + 1, 1}
+                 : std::string_view{digits, 2};
+
+    for (auto pos = find(name, 0); pos != std::string_view::npos;
+         pos      = find(name, pos + replacement.size()))
+    {
+      if (!s.replace(pos, name.size(), replacement)) { return false; }
+    }
+  }
+
+  return true;
+}
+
+constexpr bool CronData::parse_number(std::string_view s, int32_t& value)
+{
+  // Values larger than any field limit are saturated rather than allowed to
+  // overflow; they fail the range check later on.
+  constexpr int32_t saturation = 1000;
+
+  value = 0;
+
+  for (auto c : s)
+  {
+    if (c < '0' || c > '9') { return false; }
+
+    value = std::min(value * 10 + (c - '0'), saturation);
+  }
+
+  return !s.empty();
+}
+
+constexpr bool CronData::is_between(int32_t value,
+                                    int32_t low_limit,
+                                    int32_t high_limit)
+{
+  return value >= low_limit && value <= high_limit;
+}
+
+constexpr bool CronData::validate_date_vs_months() const
+{
+  bool res = true;
+
+  // Verify that the available dates are possible based on the given months
+  if (months.size() == 1 && months.contains(Months::February))
+  {
+    // Only february allowed, make sure that the allowed date(s) includes 29 and
+    // below.
+    res = has_any_in_range(day_of_month, 1, 29);
+  }
+
+  if (res)
+  {
+    // Make sure that if the days contains only 31, at least one month allows
+    // that date.
+    if (day_of_month.size() == 1 && day_of_month.contains(DayOfMonth::Last))
+    {
+      res = false;
+
+      for (size_t i = 0; !res && i < NUMBER_OF_LONG_MONTHS; ++i)
+      {
+        res = months.contains(months_with_31[i]);
+      }
+    }
+  }
+
+  return res;
+}
+
+constexpr bool CronData::check_dom_vs_dow(std::string_view dom,
+                                          std::string_view dow) const
+{
+  // Day of month and day of week are mutually exclusive so one of them must at
+  // always be ignored using the '?'-character unless one field already is
+  // something other than '*'.
+  //
+  // Since we treat an ignored field as allowing the full range, we're OK with
+  // both being flagged as ignored. To make it explicit to the user of the
+  // library, we do however require the use of
+  // '?' as the ignore flag, although it is functionally equivalent to '*'.
+
+  auto check = [](std::string_view l, std::string_view r)
+  { return l == "*" && (r != "*" || r == "?"); };
+
+  return (dom == "?" || dow == "?") || check(dom, dow) || check(dow, dom);
+}
+
+namespace literals
+{
+// "0 */5 * * * ?"_cron parses the expression at compile time when used in a
+// constant expression, where an invalid expression fails to compile.
+// Evaluated at run time, an invalid expression throws std::invalid_argument.
+constexpr CronData operator""_cron(const char* cron_expression, size_t length)
+{
+  const auto c = CronData::create_constexpr({cron_expression, length});
+  if (!c) { throw std::invalid_argument("invalid cron expression"); }
+
+  return *c;
+}
+}  // namespace literals
 }  // namespace libcron
+
+// Compiles a cron expression string literal into a CronData at compile time,
+// failing the build with a static_assert if the expression is invalid.
+#define LIBCRON_CRON_EXPR(expression)                                        \
+  ([]()                                                                      \
+   {                                                                         \
+     constexpr auto parsed = ::libcron::CronData::create_constexpr(expression); \
+     static_assert(parsed.has_value(),                                       \
+                   "invalid cron expression: " expression);                  \
+     return *parsed;                                                         \
+   }())
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "libcron/CronData.h"
+
+namespace libcron
+{
+// Counters of a CronDataCache
+struct CronDataCacheStats
+{
+  uint64_t hits      = 0;
+  uint64_t misses    = 0;
+  uint64_t evictions = 0;
+};
+
+// Parsed cron expressions by their text, bounded in size by evicting the
+//  least recently used entries.
+// The cache is split into shards selected by the hash of the expression,
+//  each guarded by its own mutex, so lookups of different expressions rarely
+//  contend.
+// All methods are thread safe.
+class CronDataCache
+{
+public:
+  static constexpr size_t default_capacity = 4096;
+
+  explicit CronDataCache(size_t capacity = default_capacity);
+
+  CronDataCache(const CronDataCache&) = delete;
+
+  CronDataCache& operator=(const CronDataCache&) = delete;
+
+  // return the cached parse result of the expression, marking it as recently
+  //  used, or nothing if it is not cached
+  std::optional<CronData> find(std::string_view cron_expression);
+
+  // add or replace the parse result of the expression, evicting the least
+  //  recently used entry of its shard if the shard is full
+  void insert(std::string_view cron_expression, const CronData& data);
+
+  // parse and cache each of the given expressions
+  // returns the number of valid expressions
+  size_t prewarm(const std::vector<std::string_view>& cron_expressions);
+
+  // remove all entries; counters are kept
+  void clear();
+
+  // change the maximum number of entries, evicting entries as needed
+  void set_capacity(size_t capacity);
+
+  size_t capacity() const;
+
+  // return the number of cached entries
+  size_t size() const;
+
+  CronDataCacheStats stats() const;
+
+  void reset_stats();
+
+private:
+  static constexpr size_t shard_count = 16;
+
+  struct Shard
+  {
+    mutable std::mutex mutex;
+
+    // most recently used first; keys of the index view the strings held here
+    std::list<std::pair<std::string, CronData>> entries;
+    std::unordered_map<std::string_view,
+                       std::list<std::pair<std::string, CronData>>::iterator>
+      index;
+  };
+
+  Shard& shard_for(std::string_view cron_expression);
+
+  // evict least recently used entries until the shard fits its capacity
+  // the shard's mutex must be held
+  void trim(Shard& shard, size_t max_entries);
+
+  std::atomic<size_t>            shard_capacity;
+  std::array<Shard, shard_count> shards;
+  std::atomic<uint64_t>          hits{0};
+  std::atomic<uint64_t>          misses{0};
+  std::atomic<uint64_t>          evictions{0};
+};
+}  // namespace libcron
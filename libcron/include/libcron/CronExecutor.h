@@ -0,0 +1,159 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "libcron/Task.h"
+
+namespace libcron
+{
+// Runs the callbacks of expired tasks on behalf of Cron::tick(), which hands
+//  over each run while holding the queue lock; execute() should thus return
+//  quickly, and must not wait for callbacks that may use the Cron instance.
+class ICronExecutor
+{
+public:
+  virtual ~ICronExecutor() = default;
+
+  virtual void execute(TaskRun run) = 0;
+};
+
+// Runs each callback right away on the thread calling Cron::tick()
+class InlineExecutor : public ICronExecutor
+{
+public:
+  void execute(TaskRun run) override { run.run(); }
+};
+
+// Runs callbacks on a fixed number of worker threads, in the order they were
+//  handed over. The destructor runs any callbacks still queued, then joins the
+//  threads.
+// Callbacks must not throw; an exception escaping one terminates the program.
+class ThreadPoolExecutor : public ICronExecutor
+{
+public:
+  // start the given number of worker threads, at least one
+  explicit ThreadPoolExecutor(
+    size_t thread_count = std::thread::hardware_concurrency());
+
+  ~ThreadPoolExecutor() override;
+
+  ThreadPoolExecutor(const ThreadPoolExecutor&)            = delete;
+  ThreadPoolExecutor& operator=(const ThreadPoolExecutor&) = delete;
+
+  // this method IS thread safe
+  void execute(TaskRun run) override;
+
+  // block until all callbacks handed over so far have finished
+  // this method IS thread safe
+  void wait_idle();
+
+  size_t thread_count() const { return threads.size(); }
+
+private:
+  void work();
+
+  std::mutex               mutex;
+  std::condition_variable  available;
+  std::condition_variable  idle;
+  std::deque<TaskRun>      queue;
+  size_t                   busy     = 0;
+  bool                     stopping = false;
+  std::vector<std::thread> threads;
+};
+
+// Runs callbacks on a fixed number of worker threads, each with its own queue.
+//  Runs are handed to the workers in turn, and a worker that runs out of work
+//  takes runs from the back of the queues of the others, so that bursts of
+//  runs spread over all threads without contending for a single queue.
+// Like ThreadPoolExecutor, the destructor runs any callbacks still queued,
+//  and callbacks must not throw.
+class WorkStealingExecutor : public ICronExecutor
+{
+public:
+  // start the given number of worker threads, at least one
+  explicit WorkStealingExecutor(
+    size_t thread_count = std::thread::hardware_concurrency());
+
+  ~WorkStealingExecutor() override;
+
+  WorkStealingExecutor(const WorkStealingExecutor&)            = delete;
+  WorkStealingExecutor& operator=(const WorkStealingExecutor&) = delete;
+
+  // this method IS thread safe
+  void execute(TaskRun run) override;
+
+  // block until all callbacks handed over so far have finished
+  // this method IS thread safe
+  void wait_idle();
+
+  size_t thread_count() const { return threads.size(); }
+
+private:
+  struct Worker
+  {
+    std::mutex          mutex;
+    std::deque<TaskRun> queue;
+  };
+
+  void work(size_t index);
+
+  // the next run from the front of the queue of the given worker, or else
+  //  from the back of that of another one
+  std::optional<TaskRun> take(size_t index);
+
+  std::vector<std::unique_ptr<Worker>> workers;
+  std::atomic<size_t>                  next_worker{0};
+  // runs waiting in a queue; may briefly be off by the runs being moved
+  std::atomic<std::ptrdiff_t>          queued{0};
+  // runs handed over and not yet finished
+  std::atomic<size_t>                  unfinished{0};
+  std::atomic<size_t>                  sleeping{0};
+
+  // for workers to sleep on when there is nothing to take
+  std::mutex               mutex;
+  std::condition_variable  available;
+  std::condition_variable  idle;
+  bool                     stopping = false;
+  std::vector<std::thread> threads;
+};
+
+// Runs callbacks on a number of serial lanes, each with a single worker
+//  thread. The runs of tasks with an execution key go to the lane chosen by
+//  the hash of the key, so tasks sharing a key never run concurrently, while
+//  those with other keys run in parallel unless their keys share a lane. Runs
+//  without a key are handed to the lanes in turn.
+// Like ThreadPoolExecutor, the destructor runs any callbacks still queued,
+//  and callbacks must not throw.
+class KeyedExecutor : public ICronExecutor
+{
+public:
+  // start the given number of lanes, at least one
+  explicit KeyedExecutor(
+    size_t lane_count = std::thread::hardware_concurrency());
+
+  // this method IS thread safe
+  void execute(TaskRun run) override;
+
+  // block until all callbacks handed over so far have finished
+  // this method IS thread safe
+  void wait_idle();
+
+  size_t lane_count() const { return lanes.size(); }
+
+  // the lane that runs the tasks with the given execution key
+  size_t lane_of(const std::string& key) const;
+
+private:
+  std::vector<std::unique_ptr<ThreadPoolExecutor>> lanes;
+  std::atomic<size_t>                              next_lane{0};
+};
+}  // namespace libcron
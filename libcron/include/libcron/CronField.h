@@ -0,0 +1,207 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <type_traits>
+
+namespace libcron
+{
+namespace detail
+{
+constexpr int popcount(uint64_t v)
+{
+#if defined(__GNUC__) || defined(__clang__)
+  return __builtin_popcountll(v);
+#else
+  int count = 0;
+  for (; v != 0; v &= v - 1) { ++count; }
+  return count;
+#endif
+}
+
+// Index of the lowest set bit; v must not be zero.
+constexpr int countr_zero(uint64_t v)
+{
+#if defined(__GNUC__) || defined(__clang__)
+  return __builtin_ctzll(v);
+#else
+  int count = 0;
+  for (; (v & 1) == 0; v >>= 1) { ++count; }
+  return count;
+#endif
+}
+
+// Index of the highest set bit; v must not be zero.
+constexpr int highest_bit(uint64_t v)
+{
+#if defined(__GNUC__) || defined(__clang__)
+  return 63 - __builtin_clzll(v);
+#else
+  int index = 0;
+  for (; v > 1; v >>= 1) { ++index; }
+  return index;
+#endif
+}
+
+// Smallest unsigned type with a bit for each value in [0, last]
+template<int last>
+using field_storage_t = std::conditional_t<
+  (last < 8),
+  uint8_t,
+  std::conditional_t<(last < 16),
+                     uint16_t,
+                     std::conditional_t<(last < 32), uint32_t, uint64_t>>>;
+}  // namespace detail
+
+// A set of the allowed values of one cron field (seconds, months, ...), stored
+// as a bitmask where bit N represents value N. It offers the read-only part of
+// the std::set interface so that it can be used as a drop-in view of the
+// field, but is trivially copyable and only as wide as the field requires.
+template<typename T>
+class CronField
+{
+public:
+  using value_type   = T;
+  using storage_type = detail::field_storage_t<static_cast<int>(T::Last)>;
+
+  class const_iterator
+  {
+  public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type        = T;
+    using difference_type   = std::ptrdiff_t;
+    using pointer           = const T*;
+    using reference         = T;
+
+    constexpr const_iterator() = default;
+
+    constexpr explicit const_iterator(storage_type remaining)
+      : remaining(remaining)
+    {
+    }
+
+    constexpr T operator*() const
+    {
+      return static_cast<T>(detail::countr_zero(remaining));
+    }
+
+    constexpr const_iterator& operator++()
+    {
+      remaining &= static_cast<storage_type>(remaining - 1);
+      return *this;
+    }
+
+    constexpr const_iterator operator++(int)
+    {
+      auto copy = *this;
+      ++*this;
+      return copy;
+    }
+
+    constexpr bool operator==(const const_iterator& other) const
+    {
+      return remaining == other.remaining;
+    }
+
+    constexpr bool operator!=(const const_iterator& other) const
+    {
+      return remaining != other.remaining;
+    }
+
+  private:
+    storage_type remaining = 0;
+  };
+
+  using iterator = const_iterator;
+
+  constexpr CronField() = default;
+
+  constexpr const_iterator begin() const { return const_iterator{mask}; }
+
+  constexpr const_iterator end() const { return const_iterator{}; }
+
+  constexpr size_t size() const
+  {
+    return static_cast<size_t>(detail::popcount(mask));
+  }
+
+  constexpr bool empty() const { return mask == 0; }
+
+  constexpr bool contains(T value) const { return (mask & bit(value)) != 0; }
+
+  constexpr size_t count(T value) const { return contains(value) ? 1 : 0; }
+
+  // Returns an iterator to the given value, or end() if it is not present
+  constexpr const_iterator find(T value) const
+  {
+    return contains(value) ? const_iterator{static_cast<storage_type>(
+                               mask & ~(bit(value) - 1))}
+                           : end();
+  }
+
+  constexpr void insert(T value) { mask |= bit(value); }
+
+  constexpr void emplace(T value) { insert(value); }
+
+  constexpr void erase(T value)
+  {
+    mask &= static_cast<storage_type>(~bit(value));
+  }
+
+  constexpr void clear() { mask = 0; }
+
+  // Smallest value in the field that is >= from, or -1 if there is none
+  constexpr int next(int from) const
+  {
+    const uint64_t remaining =
+      from > static_cast<int>(T::Last)
+        ? 0
+        : uint64_t{mask} & (~uint64_t{0} << (from < 0 ? 0 : from));
+    return remaining == 0 ? -1 : detail::countr_zero(remaining);
+  }
+
+  // Number of values in the field that are >= from
+  constexpr size_t count_from(int from) const
+  {
+    const uint64_t remaining =
+      from > static_cast<int>(T::Last)
+        ? 0
+        : uint64_t{mask} & (~uint64_t{0} << (from < 0 ? 0 : from));
+    return static_cast<size_t>(detail::popcount(remaining));
+  }
+
+  // Largest value in the field that is <= from, or -1 if there is none
+  constexpr int prev(int from) const
+  {
+    const uint64_t remaining =
+      from < 0 ? 0
+      : from >= 63
+        ? uint64_t{mask}
+        : uint64_t{mask} & ((uint64_t{1} << (from + 1)) - 1);
+    return remaining == 0 ? -1 : detail::highest_bit(remaining);
+  }
+
+  // Raw bitmask, bit N representing value N
+  constexpr storage_type bits() const { return mask; }
+
+  constexpr bool operator==(const CronField& other) const
+  {
+    return mask == other.mask;
+  }
+
+  constexpr bool operator!=(const CronField& other) const
+  {
+    return mask != other.mask;
+  }
+
+private:
+  static constexpr storage_type bit(T value)
+  {
+    return static_cast<storage_type>(storage_type{1}
+                                     << static_cast<unsigned>(value));
+  }
+
+  storage_type mask = 0;
+};
+}  // namespace libcron
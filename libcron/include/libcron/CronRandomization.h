@@ -27,7 +27,7 @@ private:
     int&                selected_value,
     std::pair<int, int> limit = std::make_pair(-1, -1));
 
-  std::pair<int, int> day_limiter(const std::set<Months>& month);
+  std::pair<int, int> day_limiter(const CronField<Months>& month);
 
   int cap(int value, int lower, int upper);
 
@@ -59,21 +59,20 @@ std::pair<bool, std::string> CronRandomization::get_random_in_range(
       right = cap(right, limit.first, limit.second);
     }
 
-    std::set<T> numbers;
+    CronField<T> numbers;
     res.first = CronData::convert_from_string_range_to_number_range<T>(
       std::to_string(left) + "-" + std::to_string(right), numbers);
 
     // Remove items outside limits.
     if (limit.first != -1 && limit.second != -1)
     {
-      for (auto it = numbers.begin(); it != numbers.end();)
+      for (auto number : numbers)
       {
-        if (CronData::value_of(*it) < limit.first ||
-            CronData::value_of(*it) > limit.second)
+        if (CronData::value_of(number) < limit.first ||
+            CronData::value_of(number) > limit.second)
         {
-          it = numbers.erase(it);
+          numbers.erase(number);
         }
-        else { ++it; }
       }
     }
 
@@ -1,6 +1,9 @@
 #pragma once
 
 #include <chrono>
+#include <cstddef>
+#include <iterator>
+#include <memory>
 #if defined(_MSC_VER)
 #  pragma warning(push)
 #  pragma warning(disable : 4244)
@@ -10,6 +13,7 @@
 #  pragma warning(pop)
 #endif
 
+#include "libcron/CalendarCursor.h"
 #include "libcron/CronData.h"
 #include "libcron/DateTime.h"
 
@@ -18,33 +22,167 @@ namespace libcron
 class CronSchedule
 {
 public:
-  explicit CronSchedule(CronData& data) : data(data) {}
+  // Input iterator over the successive occurrences of a schedule. Each step
+  //  continues the search from the broken down previous occurrence instead of
+  //  starting over from a time_point.
+  // The iterator refers to the schedule, which must outlive it.
+  class OccurrenceIterator
+  {
+  public:
+    using iterator_category = std::input_iterator_tag;
+    using value_type        = std::chrono::system_clock::time_point;
+    using difference_type   = std::ptrdiff_t;
+    using pointer           = const value_type*;
+    using reference         = const value_type&;
+
+    // the end of every range of occurrences
+    OccurrenceIterator() = default;
+
+    // the first occurrence at or after from
+    OccurrenceIterator(const CronSchedule&                   schedule,
+                       std::chrono::system_clock::time_point from);
+
+    reference operator*() const { return current; }
+
+    pointer operator->() const { return &current; }
+
+    OccurrenceIterator& operator++();
+
+    OccurrenceIterator operator++(int)
+    {
+      auto copy = *this;
+      ++*this;
+      return copy;
+    }
+
+    bool operator==(const OccurrenceIterator& other) const
+    {
+      return schedule == other.schedule
+             && (schedule == nullptr || current == other.current);
+    }
+
+    bool operator!=(const OccurrenceIterator& other) const
+    {
+      return !(*this == other);
+    }
+
+  private:
+    void advance();
+
+    // null once the schedule has no further occurrence
+    const CronSchedule* schedule = nullptr;
+    CalendarCursor      cursor{};
+    value_type          current{};
+  };
+
+  // The occurrences of a schedule from a point in time on, as a range for use
+  //  in range-based for loops; it ends if the schedule runs out of occurrences
+  class OccurrenceRange
+  {
+  public:
+    OccurrenceRange(const CronSchedule&                   schedule,
+                    std::chrono::system_clock::time_point from)
+      : schedule(&schedule), from(from)
+    {
+    }
+
+    OccurrenceIterator begin() const { return {*schedule, from}; }
+
+    OccurrenceIterator end() const { return {}; }
+
+  private:
+    const CronSchedule*                   schedule;
+    std::chrono::system_clock::time_point from;
+  };
+
+  explicit CronSchedule(const CronData& data) : data(data) {}
 
   CronSchedule(const CronSchedule&) = default;
 
+  // return the shared, immutable schedule for the given data
+  // schedules selecting the same values share one instance, which lives as
+  //  long as anything refers to it
+  // this method IS thread safe
+  static std::shared_ptr<const CronSchedule> intern(const CronData& data);
+
+  // return the number of interned schedules that are still referred to
+  // this method IS thread safe
+  static size_t interned_count();
+
+  const CronData& get_data() const { return data; }
+
   std::tuple<bool, std::chrono::system_clock::time_point> calculate_from(
     const std::chrono::system_clock::time_point& from) const;
 
-  // https://github.com/HowardHinnant/date/wiki/Examples-and-Recipes#obtaining-ymd-hms-components-from-a-time_point
+  // Same as above, also reporting the number of steps the search took. Each
+  // step moves at least one field forward, so the count stays small (a few
+  // dozen at most) regardless of how sparse the schedule is.
+  std::tuple<bool, std::chrono::system_clock::time_point> calculate_from(
+    const std::chrono::system_clock::time_point& from,
+    uint32_t&                                    iterations) const;
+
+  // return the most recent occurrence at or before from, like calculate_from()
+  //  searching backwards
+  std::tuple<bool, std::chrono::system_clock::time_point> calculate_before(
+    const std::chrono::system_clock::time_point& from) const;
+
+  // Same as above, also reporting the number of steps the search took, which
+  // is bounded like that of calculate_from().
+  std::tuple<bool, std::chrono::system_clock::time_point> calculate_before(
+    const std::chrono::system_clock::time_point& from,
+    uint32_t&                                    iterations) const;
+
+  // return the number of occurrences at or after from and before until
+  // whole days and months are counted from the number of allowed values of
+  //  each field rather than by enumerating occurrences, so this is
+  //  O(number of months) whatever the density of the schedule
+  uint64_t count_between(std::chrono::system_clock::time_point from,
+                         std::chrono::system_clock::time_point until) const;
+
+  // return the occurrences at or after from, calculated lazily; the range
+  //  refers to this schedule, which must outlive it
+  // enumerating consecutive occurrences this way is cheaper than repeated
+  //  calls to calculate_from()
+  OccurrenceRange occurrences(std::chrono::system_clock::time_point from) const
+  {
+    return OccurrenceRange{*this, from};
+  }
+
   static DateTime to_calendar_time(std::chrono::system_clock::time_point time)
   {
-    auto daypoint = date::floor<date::days>(time);
-    auto ymd      = date::year_month_day(daypoint);  // calendar date
-    auto time_of_day =
-      date::make_time(time - daypoint);              // Yields time_of_day type
-
-    // Obtain individual components as integers
-    DateTime dt{int(ymd.year()),
-                unsigned(ymd.month()),
-                unsigned(ymd.day()),
-                static_cast<uint8_t>(time_of_day.hours().count()),
-                static_cast<uint8_t>(time_of_day.minutes().count()),
-                static_cast<uint8_t>(time_of_day.seconds().count())};
-
-    return dt;
+    return CalendarCursor{time}.to_date_time();
   }
 
 private:
+  // Search at most this many years ahead. A valid schedule always has an
+  // occurrence within eight years (29th of February across a skipped leap
+  // year).
+  static constexpr int max_years_ahead = 10;
+
+  // Move the cursor to the first occurrence at or after it, returning false
+  // if there is none within max_years_ahead.
+  bool find_next(CalendarCursor& c, uint32_t& iterations) const;
+
+  // Move the cursor to the last occurrence at or before it, returning false
+  // if there is none within max_years_ahead.
+  bool find_previous(CalendarCursor& c, uint32_t& iterations) const;
+
+  // First allowed day in the month of the cursor that is >= its day, or -1 if
+  // there is none. Honours the day of month vs day of week precedence.
+  int next_day(const CalendarCursor& c) const;
+
+  // Number of occurrences within a day at or after the time of day in c
+  uint64_t count_in_day_from(const CalendarCursor& c) const;
+
+  // Number of allowed days from first to last, inclusive, both in the month
+  // of the cursor
+  uint64_t count_days(const CalendarCursor& c, unsigned first, unsigned last)
+    const;
+
+  // Last allowed day in the month of the cursor that is <= its day, or -1 if
+  // there is none. The day may lie past the end of the month.
+  int previous_day(const CalendarCursor& c) const;
+
   CronData data;
 };
 
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <chrono>
+#include <vector>
+
+#include "libcron/QueueEngine.h"
+
+namespace libcron
+{
+// Indexed binary min-heap on the time each slot is due
+class HeapEngine : public IQueueEngine
+{
+public:
+  void insert(size_t slot, std::chrono::system_clock::time_point when) override;
+
+  void erase(size_t slot) override;
+
+  void update(size_t slot, std::chrono::system_clock::time_point when) override;
+
+  size_t next_due(std::chrono::system_clock::time_point now) override;
+
+  size_t earliest() const override;
+
+  void clear() override;
+
+private:
+  bool earlier(size_t lhs_position, size_t rhs_position) const;
+
+  void swap_positions(size_t lhs_position, size_t rhs_position);
+
+  void sift_up(size_t position);
+
+  void sift_down(size_t position);
+
+  // slots arranged as a binary min-heap on their due time
+  std::vector<size_t> heap;
+
+  // heap position and due time of each slot
+  std::vector<size_t>                                position;
+  std::vector<std::chrono::system_clock::time_point> due;
+};
+}  // namespace libcron
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <limits>
+
+namespace libcron
+{
+// Selects the data structure TaskQueue uses to order tasks by their next
+// schedule.
+enum class QueueEngineType
+{
+  // Indexed binary min-heap; O(log n) insert, cancel and expiry.
+  BinaryHeap,
+  // Hierarchical timing wheel with second, minute, hour and day levels; O(1)
+  // insert and cancel, amortized O(1) expiry per tick. Suited for very large
+  // numbers of tasks.
+  TimingWheel
+};
+
+// Orders the task slots of a TaskQueue by the time they are due. Slots are
+// small, dense indexes owned by the TaskQueue.
+class IQueueEngine
+{
+public:
+  static constexpr size_t npos = std::numeric_limits<size_t>::max();
+
+  virtual ~IQueueEngine() = default;
+
+  // add a slot which is due at the given time
+  virtual void insert(size_t slot, std::chrono::system_clock::time_point when) = 0;
+
+  // remove a previously inserted slot
+  virtual void erase(size_t slot) = 0;
+
+  // change the time a previously inserted slot is due at
+  virtual void update(size_t slot, std::chrono::system_clock::time_point when) = 0;
+
+  // return a slot that is due at or before now, or npos if there is none
+  // the caller is expected to update() or erase() the returned slot before
+  //  asking again
+  virtual size_t next_due(std::chrono::system_clock::time_point now) = 0;
+
+  // return the slot that is due first, or npos if there are none
+  virtual size_t earliest() const = 0;
+
+  // remove all slots
+  virtual void clear() = 0;
+};
+}  // namespace libcron
@@ -1,11 +1,18 @@
 #pragma once
 
+#include <atomic>
 #include <chrono>
+#include <cstdint>
 #include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
 #include <utility>
 
 #include "libcron/CronData.h"
 #include "libcron/CronSchedule.h"
+#include "libcron/TimeZone.h"
 
 namespace libcron
 {
@@ -15,30 +22,98 @@ public:
   virtual ~TaskInformation()                                    = default;
   virtual std::chrono::system_clock::duration get_delay() const = 0;
   virtual std::string                         get_name() const  = 0;
+
+  // the task name without copying it; valid as long as the task exists, and
+  //  for a run handed to a callback, as long as the run exists
+  virtual std::string_view get_name_view() const = 0;
+
+  // the most recent occurrence that was skipped rather than run because the
+  //  schedule was recalculated past it, e.g. after a clock change of 3h or
+  //  more; time_point::min() if there is none
+  virtual std::chrono::system_clock::time_point get_last_missed() const = 0;
+};
+
+// How a task that expires while an earlier run of its callback is still in
+//  progress on another thread is handled
+enum class OverlapPolicy
+{
+  // run the callbacks concurrently
+  Allow,
+  // do not run the callback for this expiry
+  Skip,
+  // run the callback once more after the current run, however many times the
+  //  task expired in the meantime
+  Coalesce,
+  // run the callback after the current run, once for each expiry
+  Serialize
 };
 
+// The runs of a task that are in progress or pending behind one, shared by the
+//  task and its runs and updated without locking
+class TaskRunState
+{
+public:
+  // return whether a run for a new expiry should start now under the given
+  //  policy; otherwise it is left pending or dropped
+  bool begin(OverlapPolicy policy);
+
+  // end a run, returning whether a pending one is to follow
+  bool end();
+
+  // end a run that failed, dropping any pending ones
+  void abandon();
+
+private:
+  // number of runs in progress plus pending ones
+  std::atomic<uint32_t> runs{0};
+};
+
+class TaskRun;
+
 class Task : public TaskInformation
 {
 public:
   using TaskFunction = std::function<void(const TaskInformation&)>;
 
-  Task(std::string name, const CronSchedule schedule, TaskFunction task)
-    : name(std::move(name)),
+  // a task whose schedule is evaluated in the given time zone, if any, rather
+  //  than in the time of the clock
+  Task(std::string                         name,
+       std::shared_ptr<const CronSchedule> schedule,
+       TaskFunction                        task,
+       std::shared_ptr<const TimeZone>     zone = nullptr)
+    : name(std::make_shared<const std::string>(std::move(name))),
       schedule(std::move(schedule)),
-      task(std::move(task))
+      zone(std::move(zone)),
+      task(std::make_shared<const TaskFunction>(std::move(task)))
   {
   }
 
-  void execute(std::chrono::system_clock::time_point now)
+  Task(std::string name, const CronSchedule& schedule, TaskFunction task)
+    : Task(std::move(name),
+           CronSchedule::intern(schedule.get_data()),
+           std::move(task))
   {
-    // Next Schedule is still the current schedule, calculate delay (actual
-    // execution - planned execution)
-    delay = now - next_schedule;
-
-    last_run = now;
-    task(*this);
   }
 
+  // run the callback right away, subject to the overlap policy
+  void execute(std::chrono::system_clock::time_point now);
+
+  // like execute(), but instead of calling the callback return a run of it,
+  //  to be handed to an executor; the delay is that of the dispatch
+  // returns nothing if the overlap policy holds the run back
+  std::optional<TaskRun> dispatch(std::chrono::system_clock::time_point now);
+
+  // how to handle expiring while a previous run is still in progress
+  void set_overlap_policy(OverlapPolicy policy);
+
+  OverlapPolicy get_overlap_policy() const { return overlap; }
+
+  // tasks with the same execution key are run one at a time by executors
+  //  that honour keys, such as KeyedExecutor; an empty key means none
+  void set_execution_key(std::string key);
+
+  const std::string& get_execution_key() const { return execution_key; }
+
   std::chrono::system_clock::duration get_delay() const override
   {
     return delay;
@@ -46,10 +121,53 @@ public:
 
   Task(const Task& other) = default;
 
+  Task(Task&& other) = default;
+
   Task& operator=(const Task&) = default;
 
+  Task& operator=(Task&&) = default;
+
   bool calculate_next(std::chrono::system_clock::time_point from);
 
+  // calculate the next occurrence of the given schedule from the given point
+  //  in time, in the given time zone if any
+  static std::tuple<bool, std::chrono::system_clock::time_point> next_from(
+    const CronSchedule&                   schedule,
+    const TimeZone*                       zone,
+    std::chrono::system_clock::time_point from);
+
+  // apply a next schedule already calculated by this task's schedule, as
+  //  returned by CronSchedule::calculate_from()
+  bool set_next(
+    const std::tuple<bool, std::chrono::system_clock::time_point>& next);
+
+  // record an occurrence that was skipped rather than run
+  void set_missed(std::chrono::system_clock::time_point missed)
+  {
+    last_missed = missed;
+  }
+
+  std::chrono::system_clock::time_point get_last_missed() const override
+  {
+    return last_missed;
+  }
+
+  // replace the schedule and calculate the next schedule from now, keeping
+  //  the callback and execution state; a task that already ran within the
+  //  last second is not scheduled again within that second
+  bool reschedule(std::shared_ptr<const CronSchedule> new_schedule,
+                  std::chrono::system_clock::time_point now);
+
+  // the schedule, shared with all tasks using the same one
+  const std::shared_ptr<const CronSchedule>& get_schedule() const
+  {
+    return schedule;
+  }
+
+  // the time zone the schedule is evaluated in, or nullptr for the time of
+  //  the clock
+  const std::shared_ptr<const TimeZone>& get_time_zone() const { return zone; }
+
   bool operator>(const Task& other) const
   {
     return next_schedule > other.next_schedule;
@@ -65,38 +183,115 @@ public:
   std::chrono::system_clock::duration time_until_expiry(
     std::chrono::system_clock::time_point now) const;
 
-  std::string get_name() const override { return name; }
+  std::string get_name() const override { return std::string{get_name_view()}; }
+
+  std::string_view get_name_view() const override
+  {
+    return name ? std::string_view{*name} : std::string_view{};
+  }
+
+  std::chrono::system_clock::time_point get_next_schedule() const
+  {
+    return next_schedule;
+  }
 
   std::string get_status(std::chrono::system_clock::time_point now) const;
 
 private:
-  std::string                           name;
-  CronSchedule                          schedule;
+  // shared by copies of the task and the runs dispatched from it, so that
+  //  views of the name stay valid for as long as either exists
+  std::shared_ptr<const std::string>    name;
+  std::shared_ptr<const CronSchedule>   schedule;
+  std::shared_ptr<const TimeZone>       zone;
   std::chrono::system_clock::time_point next_schedule;
   std::chrono::system_clock::duration   delay = std::chrono::seconds(-1);
-  TaskFunction                          task;
+  // shared by copies of the task and the runs dispatched from it
+  std::shared_ptr<const TaskFunction>   task;
+  OverlapPolicy                         overlap = OverlapPolicy::Allow;
+  // created once the policy is other than Allow
+  std::shared_ptr<TaskRunState>         run_state;
+  std::string                           execution_key;
+  // hash of the execution key, passed on to runs
+  std::optional<size_t>                 key_hash;
   bool                                  valid = false;
   std::chrono::system_clock::time_point last_run =
     std::numeric_limits<std::chrono::system_clock::time_point>::min();
+  // unlike last_run, not moved by calculate_next()
+  std::chrono::system_clock::time_point last_executed =
+    std::numeric_limits<std::chrono::system_clock::time_point>::min();
+  std::chrono::system_clock::time_point last_missed =
+    std::chrono::system_clock::time_point::min();
+};
+
+// A single run of the callback of a task, as dispatched by Cron::tick() to an
+//  ICronExecutor. It carries the task information as of the dispatch, so it
+//  stays valid and unaffected while the task is rescheduled or removed.
+class TaskRun : public TaskInformation
+{
+public:
+  TaskRun(std::shared_ptr<const std::string>        name,
+          std::shared_ptr<const Task::TaskFunction> task,
+          std::shared_ptr<TaskRunState>             state,
+          std::chrono::system_clock::duration       delay,
+          std::chrono::system_clock::time_point     last_missed,
+          std::optional<size_t>                     key_hash = std::nullopt)
+    : name(std::move(name)),
+      task(std::move(task)),
+      state(std::move(state)),
+      delay(delay),
+      last_missed(last_missed),
+      key_hash(key_hash)
+  {
+  }
+
+  // call the callback with this run as its task information, followed by
+  //  any runs the overlap policy left pending meanwhile, which are given the
+  //  same information
+  void run() const;
+
+  std::chrono::system_clock::duration get_delay() const override
+  {
+    return delay;
+  }
+
+  std::string get_name() const override { return *name; }
+
+  std::string_view get_name_view() const override { return *name; }
+
+  std::chrono::system_clock::time_point get_last_missed() const override
+  {
+    return last_missed;
+  }
+
+  // the hash of the execution key of the task, if it has one
+  std::optional<size_t> get_key_hash() const { return key_hash; }
+
+private:
+  std::shared_ptr<const std::string>        name;
+  std::shared_ptr<const Task::TaskFunction> task;
+  std::shared_ptr<TaskRunState>             state;
+  std::chrono::system_clock::duration       delay;
+  std::chrono::system_clock::time_point     last_missed;
+  std::optional<size_t>                     key_hash;
 };
 }  // namespace libcron
 
-inline bool operator==(const std::string& lhs, const libcron::Task& rhs)
+inline bool operator==(std::string_view lhs, const libcron::Task& rhs)
 {
-  return lhs == rhs.get_name();
+  return lhs == rhs.get_name_view();
 }
 
-inline bool operator==(const libcron::Task& lhs, const std::string& rhs)
+inline bool operator==(const libcron::Task& lhs, std::string_view rhs)
 {
-  return lhs.get_name() == rhs;
+  return lhs.get_name_view() == rhs;
 }
 
-inline bool operator!=(const std::string& lhs, const libcron::Task& rhs)
+inline bool operator!=(std::string_view lhs, const libcron::Task& rhs)
 {
   return !(lhs == rhs);
 }
 
-inline bool operator!=(const libcron::Task& lhs, const std::string& rhs)
+inline bool operator!=(const libcron::Task& lhs, std::string_view rhs)
 {
   return !(lhs == rhs);
 }
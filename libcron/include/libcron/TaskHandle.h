@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstdint>
+#include <limits>
+
+namespace libcron
+{
+// Identifies a task scheduled in a Cron instance without referring to its
+//  name. A handle consists of the slot the task is stored in and the
+//  generation of that slot; once the task is removed the slot's generation
+//  changes, so stale handles never refer to a task that later reuses the slot.
+// A default constructed handle refers to no task.
+struct TaskHandle
+{
+  static constexpr uint32_t no_index = std::numeric_limits<uint32_t>::max();
+
+  uint32_t index      = no_index;
+  uint32_t generation = 0;
+
+  explicit operator bool() const { return index != no_index; }
+
+  bool operator==(const TaskHandle& other) const
+  {
+    return index == other.index && generation == other.generation;
+  }
+
+  bool operator!=(const TaskHandle& other) const { return !(*this == other); }
+};
+}  // namespace libcron
@@ -1,32 +1,38 @@
 #pragma once
 
+#include <chrono>
 #include <memory>
 #include <string>
+#include <string_view>
+#include <tuple>
+#include <unordered_map>
 #include <vector>
 
 #include "libcron/CronLock.h"
+#include "libcron/QueueEngine.h"
 #include "libcron/Task.h"
+#include "libcron/TaskHandle.h"
 
 namespace libcron
 {
+// Tasks ordered by their next schedule. Tasks are held in stable slots, and
+//  a hash index maps task names to slots.
+// Tasks sharing their (interned) schedule, time zone and next schedule form a
+//  group, which expires as a unit: its next schedule is calculated once for
+//  all its tasks. The ordering of groups is delegated to an IQueueEngine.
 class TaskQueue
 {
 public:
-  // instantiate a task queue with the given lock, or with a NullLock
+  // instantiate a task queue with the given lock, or with a NullLock, using
+  //  the given engine to order its tasks
   explicit TaskQueue(
-    std::shared_ptr<ICronLock> lock = std::make_shared<NullLock>());
+    std::shared_ptr<ICronLock> lock   = std::make_shared<NullLock>(),
+    QueueEngineType            engine = QueueEngineType::BinaryHeap);
 
-  // get read-only reference to task list
-  // this method is NOT thread safe
-  // return value should not be assumed valid beyond the life of the
-  //  TaskQueue instance that provided it
-  const std::vector<Task>& get_tasks() const;
-
-  // get a mutable reference to task list
-  // this method is NOT thread safe
-  // return value should not be assumed valid beyond the life of the
-  //  TaskQueue instance that provided it
-  std::vector<Task>& get_tasks();
+  // the moved-from queue is left empty, sharing the lock and using an engine
+  //  of the same type
+  TaskQueue(TaskQueue&& other);
+  TaskQueue& operator=(TaskQueue&& other);
 
   // return number of tasks in the queue
   // this method is NOT thread safe
@@ -36,53 +42,102 @@ public:
   // this method is NOT thread safe
   bool empty() const noexcept;
 
-  // push a task onto the queue
+  // push a task onto the queue, placing it according to its next schedule
   // this will likely copy-construct a new instance from the given one
-  // does not sort the queue
+  // returns a handle to the queued task
   // this method is NOT thread safe
-  void push(Task& t);
+  TaskHandle push(Task& t);
 
-  // move a task onto the queue
+  // move a task onto the queue, placing it according to its next schedule
   // this will likely move-construct a new instance from the given one
-  // does not sort the queue
+  // returns a handle to the queued task
+  // this is O(log n) for the heap engine, O(1) for the timing wheel
   // this method is NOT thread safe
-  void push(Task&& t);
+  TaskHandle push(Task&& t);
 
-  // move an ordered sequence of tasks onto the queue
-  // does not sort the queue
+  // move a sequence of tasks onto the queue
   // this method is NOT thread safe
   void push(std::vector<Task>& tasks_to_insert);
 
-  // returns a read-only reference to the first queued task
+  // returns the task the handle refers to, or nullptr if it has been removed
+  // this is O(1)
+  // this method is NOT thread safe
+  const Task* find(TaskHandle handle) const;
+
+  // returns a read-only reference to the task with the earliest schedule
   // does not check for the existence of said task
+  // this is O(1) for the heap engine; the timing wheel searches its buckets
   // this method is NOT thread safe
   const Task& top() const;
 
-  // returns a mutable reference to the task at the given index
-  // does not check for the existence of said task
+  // call the given function for each task whose next schedule is at or
+  //  before now, earliest first for the heap engine and in no particular
+  //  order within a second for the timing wheel, nor within a group
+  // afterwards the next schedule of each expired group is calculated once,
+  //  from next_from which must be past now, and applied to all of its tasks;
+  //  tasks that no longer expire are removed
+  // the function may remove or update tasks, including the one it was called
+  //  for; tasks that left their group by then are not called or moved on
+  // returns the number of tasks the function was called for
+  // this method is NOT thread safe
+  template<typename Function>
+  size_t expire(std::chrono::system_clock::time_point now,
+                std::chrono::system_clock::time_point next_from,
+                Function                              f);
+
+  // calculate the next schedule of all tasks from the given point in time,
+  //  once per group
+  // tasks that were due before that point in time are skipped past their
+  //  missed occurrences; the most recent of these is recorded on the task
+  // this method is NOT thread safe
+  void recalculate_all(std::chrono::system_clock::time_point from);
+
+  // return the number of groups of tasks sharing schedule and next schedule
+  // this method is NOT thread safe
+  size_t group_count() const noexcept;
+
+  // call the given function for a task with the given name, then move it
+  //  according to its next schedule
+  // the function returns false to have the task removed instead
+  // returns whether a task with the given name was found
+  // this is O(log n) for the heap engine, O(1) for the timing wheel
+  // this method is NOT thread safe
+  template<typename Function>
+  bool update(std::string_view name, Function f);
+
+  // call the given function for each task, in no particular order
   // this method is NOT thread safe
-  Task& at(const size_t i);
+  template<typename Function>
+  void for_each(Function f) const;
 
-  // sort queued tasks
-  // sort order is determined by Task's operator<() method
+  // call the given function for each task, in no particular order, then
+  //  restore queue order as the function may change next schedules
+  // prefer recalculate_all() which calculates once per group
+  // this is O(n log n) for the heap engine, O(n) for the timing wheel
   // this method is NOT thread safe
-  void sort();
+  template<typename Function>
+  void update_all(Function f);
+
+  // return the tasks ordered by their next schedule
+  // return value should not be assumed valid beyond the next modification
+  //  of the TaskQueue instance that provided it
+  // this is O(n log n)
+  // this method is NOT thread safe
+  std::vector<const Task*> sorted() const;
 
   // clear the queue, destroying all contained tasks
   // this method IS thread safe
   void clear();
 
-  // remove first copy of the given task from the queue
-  // equivalency is determined by Task's operator==(string, Task)
-  //  method
-  // this method is NOT thread safe
-  void remove(Task& to_remove);
+  // remove a task with the given name from the queue
+  // this is O(1) on average, plus the cost of removing it from the engine
+  // this method IS thread safe
+  void remove(std::string_view to_remove);
 
-  // remove first task with the given name from the queue
-  // equivalency is determined by Task's operator==(string, Task)
-  //  method
+  // remove the task the handle refers to, returning whether it was present
+  // this is O(1), plus the cost of removing it from the engine
   // this method IS thread safe
-  void remove(const std::string& to_remove);
+  bool remove(TaskHandle to_remove);
 
   // block other lock_queue() or thread safe method calls until the
   //  caller subsequently calls release_queue()
@@ -93,7 +148,164 @@ public:
   void release_queue() const;
 
 private:
+  struct GroupKey
+  {
+    const CronSchedule*                   schedule;
+    const TimeZone*                       zone;
+    std::chrono::system_clock::time_point when;
+
+    bool operator==(const GroupKey& other) const
+    {
+      return schedule == other.schedule && zone == other.zone
+             && when == other.when;
+    }
+  };
+
+  struct GroupKeyHash
+  {
+    size_t operator()(const GroupKey& key) const;
+  };
+
+  struct Group
+  {
+    GroupKey            key;
+    std::vector<size_t> members;
+  };
+
+  static std::unique_ptr<IQueueEngine> make_engine(QueueEngineType type);
+
+  size_t allocate_slot(Task&& t);
+
+  void erase_slot(size_t slot);
+
+  bool is_current(TaskHandle handle) const;
+
+  static GroupKey key_of(const Task& t);
+
+  // add the task in the slot to the group matching its schedule and next
+  //  schedule, creating the group if needed
+  void join_group(size_t slot);
+
+  // remove the task in the slot from its group, dropping the group once empty
+  void leave_group(size_t slot);
+
+  // give the group a new next schedule, merging it into an existing group
+  //  with the same key
+  void move_group(size_t group, std::chrono::system_clock::time_point when);
+
+  void free_group(size_t group);
+
   mutable std::shared_ptr<ICronLock> lockSptr;
-  std::vector<Task>          c;
+
+  QueueEngineType               engine_type;
+  std::unique_ptr<IQueueEngine> engine;
+
+  // task storage; free slots are empty and listed in free_slots
+  std::vector<std::unique_ptr<Task>> slots;
+  std::vector<size_t>                free_slots;
+
+  // generation of each slot, advanced whenever its task is removed
+  std::vector<uint32_t> generations;
+
+  // group of each slot, and the slot's position among the group's members
+  std::vector<size_t> group_of;
+  std::vector<size_t> member_index;
+
+  // groups by their key; free groups are listed in free_groups
+  std::vector<Group>                                  groups;
+  std::vector<size_t>                                 free_groups;
+  std::unordered_map<GroupKey, size_t, GroupKeyHash> group_by_key;
+
+  // slots by task name; keys view the names held by the tasks themselves,
+  //  which stay put as tasks are never moved out of their slot
+  std::unordered_multimap<std::string_view, size_t> by_name;
 };
+
+template<typename Function>
+size_t TaskQueue::expire(std::chrono::system_clock::time_point now,
+                         std::chrono::system_clock::time_point next_from,
+                         Function                              f)
+{
+  size_t count = 0;
+
+  for (auto group = engine->next_due(now); group != IQueueEngine::npos;
+       group      = engine->next_due(now))
+  {
+    // The function may remove or reschedule tasks, including those of this
+    //  group, so it works on a copy of the members and skips those that have
+    //  since left the group
+    const auto            key     = groups[group].key;
+    const auto            members = groups[group].members;
+    std::vector<uint32_t> member_generations;
+    member_generations.reserve(members.size());
+    for (auto slot : members) { member_generations.push_back(generations[slot]); }
+
+    for (size_t i = 0; i < members.size(); ++i)
+    {
+      const auto slot = members[i];
+      if (generations[slot] == member_generations[i] && group_of[slot] == group
+          && groups[group].key == key)
+      {
+        f(*slots[slot]);
+        ++count;
+      }
+    }
+
+    // Nothing is left to do if all members left the group, or it was
+    //  recalculated
+    auto it = group_by_key.find(key);
+    if (it == group_by_key.end() || it->second != group) { continue; }
+
+    const auto next = Task::next_from(*key.schedule, key.zone, next_from);
+    for (auto slot : groups[group].members) { slots[slot]->set_next(next); }
+
+    if (std::get<0>(next)) { move_group(group, std::get<1>(next)); }
+    else
+    {
+      const auto remaining = groups[group].members;
+      for (auto slot : remaining) { erase_slot(slot); }
+    }
+  }
+
+  return count;
+}
+
+template<typename Function>
+bool TaskQueue::update(std::string_view name, Function f)
+{
+  auto it = by_name.find(name);
+  if (it == by_name.end()) { return false; }
+
+  const auto slot = it->second;
+
+  leave_group(slot);
+
+  if (f(*slots[slot])) { join_group(slot); }
+  else { erase_slot(slot); }
+
+  return true;
+}
+
+template<typename Function>
+void TaskQueue::for_each(Function f) const
+{
+  for (const auto& t : slots)
+  {
+    if (t) { f(static_cast<const Task&>(*t)); }
+  }
+}
+
+template<typename Function>
+void TaskQueue::update_all(Function f)
+{
+  for (size_t slot = 0; slot < slots.size(); ++slot)
+  {
+    if (slots[slot])
+    {
+      leave_group(slot);
+      f(*slots[slot]);
+      join_group(slot);
+    }
+  }
+}
 }  // namespace libcron
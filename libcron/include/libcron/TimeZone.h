@@ -0,0 +1,102 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <vector>
+
+#include "libcron/CronSchedule.h"
+
+namespace libcron
+{
+// A change of the UTC offset of a time zone, taking effect at begin (UTC)
+struct TimeZoneTransition
+{
+  std::chrono::system_clock::time_point begin;
+  std::chrono::seconds                  offset;
+};
+
+// A time zone in which the schedule of a task is evaluated, as a table of its
+//  transitions. Schedules are matched against local civil time while their
+//  occurrences are reported in UTC:
+//  - an occurrence falling into a gap, where clocks are set forward, runs at
+//    the end of the gap, i.e. at the moment of the transition;
+//  - an occurrence falling into an overlap, where clocks are set back, runs
+//    only once, during the first pass through the repeated civil time; from
+//    within the second pass, the next occurrence is searched for after it.
+// Instances are immutable and may be shared between threads.
+class TimeZone
+{
+public:
+  // a time zone from its transitions, ordered by begin; the offset of the
+  //  first transition also applies before it
+  TimeZone(std::string name, std::vector<TimeZoneTransition> transitions);
+
+  // return the shared time zone with the given IANA name, such as
+  //  "Europe/Stockholm", or nullptr if it is unknown or the library was built
+  //  without time zone support (LIBCRON_USE_TZ)
+  // the transition table of each zone is built once, covering 1970 to 2100
+  // this method IS thread safe
+  static std::shared_ptr<const TimeZone> locate(std::string_view name);
+
+  const std::string& get_name() const { return name; }
+
+  // the UTC offset in effect at the given point in time (UTC)
+  std::chrono::seconds utc_offset(
+    std::chrono::system_clock::time_point time) const;
+
+  // the local civil time at the given point in time (UTC), using the same
+  //  representation as LocalClock
+  std::chrono::system_clock::time_point to_local(
+    std::chrono::system_clock::time_point time) const
+  {
+    return time + utc_offset(time);
+  }
+
+  // the first point in time (UTC) at or after not_before at which the civil
+  //  time is the given local time, following the gap and overlap rules above
+  std::tuple<bool, std::chrono::system_clock::time_point> to_utc(
+    std::chrono::system_clock::time_point local,
+    std::chrono::system_clock::time_point not_before) const;
+
+  // like CronSchedule::calculate_from(), matching the schedule against the
+  //  civil time of this zone; from and the result are in UTC
+  std::tuple<bool, std::chrono::system_clock::time_point> calculate_from(
+    const CronSchedule&                          schedule,
+    const std::chrono::system_clock::time_point& from) const;
+
+  // like CronSchedule::calculate_before(), matching the schedule against the
+  //  civil time of this zone; from and the result are in UTC
+  std::tuple<bool, std::chrono::system_clock::time_point> calculate_before(
+    const CronSchedule&                          schedule,
+    const std::chrono::system_clock::time_point& from) const;
+
+  // like CronSchedule::count_between(), counting the runs of the schedule in
+  //  the civil time of this zone within [from, until) (UTC), following the
+  //  gap and overlap rules above
+  // the interval is counted in pieces between transitions, each with
+  //  CronSchedule::count_between()
+  uint64_t count_between(const CronSchedule&                   schedule,
+                         std::chrono::system_clock::time_point from,
+                         std::chrono::system_clock::time_point until) const;
+
+private:
+  // the candidate points in time (UTC) of a local time: one when it is
+  //  unique, two when it is repeated, none when it falls into a gap, in which
+  //  case gap_end is the moment of the transition
+  size_t candidates(std::chrono::system_clock::time_point  local,
+                    std::chrono::system_clock::time_point (&utc)[2],
+                    std::chrono::system_clock::time_point& gap_end) const;
+
+  // the transition in effect at the given point in time (UTC), or the first
+  //  one if it is earlier; there must be at least one
+  const TimeZoneTransition& in_effect(
+    std::chrono::system_clock::time_point time) const;
+
+  std::string                     name;
+  std::vector<TimeZoneTransition> transitions;
+};
+}  // namespace libcron
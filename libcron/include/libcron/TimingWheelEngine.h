@@ -0,0 +1,95 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+#include "libcron/QueueEngine.h"
+
+namespace libcron
+{
+// Hierarchical timing wheel on the time each slot is due.
+//
+// Slots are kept in intrusive doubly linked lists, one per bucket, so that
+// insert and erase are O(1). The wheel has four levels: the seconds of the
+// current minute, the minutes of the current hour, the hours of the current
+// day and the next 512 days; anything further away waits in an overflow list.
+// As the cursor enters a new minute, hour or day the matching bucket of the
+// level above is redistributed into the levels below, so each slot is moved
+// at most once per level before it becomes due.
+class TimingWheelEngine : public IQueueEngine
+{
+public:
+  TimingWheelEngine();
+
+  void insert(size_t slot, std::chrono::system_clock::time_point when) override;
+
+  void erase(size_t slot) override;
+
+  void update(size_t slot, std::chrono::system_clock::time_point when) override;
+
+  // advances the cursor to now, then returns one of the slots that became due
+  size_t next_due(std::chrono::system_clock::time_point now) override;
+
+  // this is O(number of buckets + size of the first non-empty bucket)
+  size_t earliest() const override;
+
+  void clear() override;
+
+private:
+  static constexpr int64_t days_ahead = 512;
+
+  // Bucket layout: seconds, minutes, hours, days, then the ready and
+  //  overflow lists
+  static constexpr size_t seconds_level   = 0;
+  static constexpr size_t minutes_level   = seconds_level + 60;
+  static constexpr size_t hours_level     = minutes_level + 60;
+  static constexpr size_t days_level      = hours_level + 24;
+  static constexpr size_t ready_bucket    = days_level + days_ahead;
+  static constexpr size_t overflow_bucket = ready_bucket + 1;
+  static constexpr size_t bucket_count    = overflow_bucket + 1;
+
+  static int64_t to_seconds(std::chrono::system_clock::time_point when);
+
+  size_t bucket_for(int64_t second) const;
+
+  void link(size_t slot);
+
+  void unlink(size_t slot);
+
+  // move all slots of the given bucket into where they belong now
+  void redistribute(size_t bucket);
+
+  void enter(int64_t second);
+
+  void advance(int64_t target);
+
+  // reposition every slot relative to a new cursor
+  void reset_cursor(int64_t target);
+
+  size_t earliest_in(size_t bucket) const;
+
+  // all seconds up to and including the cursor have been processed
+  int64_t current     = 0;
+  bool    initialized = false;
+
+  // number of slots in the wheel levels, i.e. outside the ready and
+  //  overflow lists
+  size_t in_wheel = 0;
+
+  std::array<size_t, bucket_count> heads;
+
+  // non-empty buckets of the seconds, minutes and hours levels
+  uint64_t second_mask = 0;
+  uint64_t minute_mask = 0;
+  uint64_t hour_mask   = 0;
+
+  // per slot state
+  std::vector<std::chrono::system_clock::time_point> due;
+  std::vector<int64_t>                               due_second;
+  std::vector<size_t>                                prev;
+  std::vector<size_t>                                next;
+  std::vector<size_t>                                bucket_of;
+};
+}  // namespace libcron
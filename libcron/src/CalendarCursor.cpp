@@ -0,0 +1,46 @@
+#include "libcron/CalendarCursor.h"
+
+#if defined(_MSC_VER)
+#  pragma warning(push)
+#  pragma warning(disable : 4244)
+#endif
+#include <date/date.h>
+#if defined(_MSC_VER)
+#  pragma warning(pop)
+#endif
+
+using namespace std::chrono;
+using namespace date;
+
+namespace libcron
+{
+CalendarCursor::CalendarCursor(std::chrono::system_clock::time_point time)
+{
+  const auto     start    = date::floor<seconds>(time);
+  const auto     daypoint = date::floor<days>(start);
+  year_month_day ymd{daypoint};
+  auto           time_of_day = make_time(start - daypoint);
+
+  year   = int(ymd.year());
+  month  = unsigned(ymd.month());
+  day    = unsigned(ymd.day());
+  hour   = static_cast<int>(time_of_day.hours().count());
+  minute = static_cast<int>(time_of_day.minutes().count());
+  second = static_cast<int>(time_of_day.seconds().count());
+
+  start_year  = year;
+  start_month = month;
+  month_start =
+    static_cast<int64_t>(daypoint.time_since_epoch().count()) - day + 1;
+}
+
+void CalendarCursor::convert() const
+{
+  const sys_days first{
+    year_month_day{date::year{year}, date::month{month}, date::day{1}}};
+
+  start_year  = year;
+  start_month = month;
+  month_start = first.time_since_epoch().count();
+}
+}  // namespace libcron
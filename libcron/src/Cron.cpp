@@ -1,168 +1,671 @@
-#include "libcron/Cron.h"
-
-namespace libcron
-{
-Cron::Cron(std::shared_ptr<ICronLock> lock, std::shared_ptr<ICronClock> clock)
-  : lockSptr(lock), clockSptr(clock)
-{
-  if (!lockSptr) { throw std::invalid_argument("Cron(): lock is null"); }
-  if (!clockSptr) { throw std::invalid_argument("Cron(): clock is null"); }
-}
-
-Cron::Cron(std::shared_ptr<ICronClock> clock)
-  : lockSptr(std::make_shared<NullLock>()), clockSptr(clock)
-{
-  if (!lockSptr) { throw std::invalid_argument("Cron(): lock is null"); }
-  if (!clockSptr) { throw std::invalid_argument("Cron(): clock is null"); }
-}
-
-bool Cron::add_schedule(std::string        name,
-                        const std::string& schedule,
-                        Task::TaskFunction work)
-{
-  auto cron{CronData::create(schedule)};
-  if (!cron) { return false; }
-
-  tasks.lock_queue();
-  Task t{std::move(name), CronSchedule{*cron}, work};
-  if (t.calculate_next(clockSptr->now()))
-  {
-    tasks.push(std::move(t));
-    tasks.sort();
-  }
-  tasks.release_queue();
-
-  return true;
-}
-
-void Cron::clear_schedules()
-{
-  tasks.clear();
-}
-
-void Cron::remove_schedule(const std::string& name)
-{
-  tasks.remove(name);
-}
-
-size_t Cron::count() const
-{
-  return tasks.size();
-}
-
-// Tick is expected to be called at least once a second to prevent missing
-// schedules.
-size_t Cron::tick()
-{
-  return tick(clockSptr->now());
-}
-
-size_t Cron::tick(std::chrono::system_clock::time_point now)
-{
-  tasks.lock_queue();
-  size_t res = 0;
-
-  if (first_tick) { first_tick = false; }
-  else
-  {
-    constexpr auto one_second    = std::chrono::seconds{1};
-    constexpr auto three_hours   = std::chrono::hours{3};
-    auto           diff          = now - last_tick;
-    auto           absolute_diff = diff >= diff.zero() ? diff : -diff;
-    if (absolute_diff < one_second)
-    {
-      // Only allow time to flow if at least one second has passed since the
-      // last tick, either forward or backward.
-      now = last_tick;
-    }
-    else if (absolute_diff >= three_hours)
-    {
-      // https://linux.die.net/man/8/cron
-      // Time changes of more than 3 hours are considered to be corrections to
-      // the clock or timezone, and the new time is used immediately.
-      for (auto& t : tasks.get_tasks()) { t.calculate_next(now); }
-    }
-    else
-    {
-      // Change of less than three hours
-
-      // If time has moved backwards: Since tasks are not rescheduled, they
-      // won't run before we're back at least the original point in time which
-      // prevents running tasks twice.
-
-      // If time has moved forward, tasks that would have run since last tick
-      // will be run.
-    }
-  }
-
-  last_tick = now;
-
-  for (auto& t : tasks.get_tasks())
-  {
-    if (t.is_expired(now))
-    {
-      t.execute(now);
-      using namespace std::chrono_literals;
-      if (!t.calculate_next(now + 1s)) { tasks.remove(t); }
-      res++;
-    }
-  }
-
-  // Only sort if at least one task was executed
-  if (res > 0) { tasks.sort(); }
-
-  tasks.release_queue();
-  return res;
-}
-
-std::chrono::system_clock::duration Cron::time_until_next() const
-{
-  return (tasks.empty() ? std::chrono::system_clock::duration::max()
-                        : tasks.top().time_until_expiry(clockSptr->now()));
-}
-
-ICronClock& Cron::get_clock() const
-{
-  return *clockSptr;
-}
-
-void Cron::recalculate_schedule()
-{
-  tasks.lock_queue();
-  for (auto& t : tasks.get_tasks())
-  {
-    using namespace std::chrono_literals;
-    // Ensure that next schedule is in the future
-    t.calculate_next(clockSptr->now() + 1s);
-  }
-  tasks.release_queue();
-}
-
-void Cron::get_time_until_expiry_for_tasks(
-  std::vector<std::tuple<std::string, std::chrono::system_clock::duration> >&
-    status) const
-{
-  const auto& now{clockSptr->now()};
-  const auto& taskList{tasks.get_tasks()};
-  status.clear();
-  status.reserve(taskList.size());
-
-  tasks.lock_queue();
-  for (auto& t : tasks.get_tasks())
-  {
-    status.emplace_back(t.get_name(), t.time_until_expiry(now));
-  }
-  tasks.release_queue();
-}
-
-std::ostream& operator<<(std::ostream& stream, const Cron& c)
-{
-  auto now = c.clockSptr->now();
-  std::for_each(c.tasks.get_tasks().cbegin(),
-                c.tasks.get_tasks().cend(),
-                [&stream, &now](const Task& t)
-                { stream << t.get_status(now) << '\n'; });
-
-  return stream;
-}
-}  // namespace libcron
+#include "libcron/Cron.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#ifdef __linux__
+#  include <sys/timerfd.h>
+#  include <unistd.h>
+#endif
+
+namespace libcron
+{
+namespace
+{
+// The thread started by Cron::start() wakes at least this often, which is how
+//  soon it notices the system clock being set back
+constexpr auto max_sleep = std::chrono::minutes{1};
+
+// The timer behind Cron::get_timer_fd() is armed at most this far ahead, so
+//  that a task due much later, or never, cannot overflow the time it is set
+//  to; it is then simply armed again by the tick that follows
+constexpr auto max_timer = std::chrono::hours{24};
+}  // namespace
+
+// What is woken when tasks are due: the thread started by Cron::start(), and
+//  the timer behind Cron::get_timer_fd()
+struct Cron::Runner
+{
+  ~Runner()
+  {
+#ifdef __linux__
+    if (timer_fd >= 0) { close(timer_fd); }
+#endif
+  }
+
+  std::mutex              mutex;
+  std::condition_variable wake;
+  std::thread             thread;
+  bool                    running = false;
+  // whether tasks changed since the thread last looked at them
+  bool                    changed = false;
+  // created under mutex, armed with the queue locked
+  std::atomic<int>        timer_fd{-1};
+  // set by start() before the thread is created
+  std::function<void(std::exception_ptr)> on_error;
+};
+
+Cron::Cron(std::shared_ptr<ICronLock>     lock,
+           std::shared_ptr<ICronClock>    clock,
+           QueueEngineType                engine,
+           std::shared_ptr<ICronExecutor> executor)
+  : lockSptr(lock),
+    clockSptr(clock),
+    executorSptr(executor),
+    tasks(lockSptr, engine),
+    runner(std::make_unique<Runner>())
+{
+  if (!lockSptr) { throw std::invalid_argument("Cron(): lock is null"); }
+  if (!clockSptr) { throw std::invalid_argument("Cron(): clock is null"); }
+  if (!executorSptr)
+  {
+    throw std::invalid_argument("Cron(): executor is null");
+  }
+}
+
+Cron::Cron(std::shared_ptr<ICronClock> clock)
+  : lockSptr(std::make_shared<NullLock>()),
+    clockSptr(clock),
+    executorSptr(std::make_shared<InlineExecutor>()),
+    tasks(lockSptr),
+    runner(std::make_unique<Runner>())
+{
+  if (!lockSptr) { throw std::invalid_argument("Cron(): lock is null"); }
+  if (!clockSptr) { throw std::invalid_argument("Cron(): clock is null"); }
+}
+
+Cron::~Cron()
+{
+  stop();
+}
+
+Cron::Cron(Cron&& other)
+  : lockSptr(other.lockSptr),
+    clockSptr(other.clockSptr),
+    executorSptr(other.executorSptr),
+    tasks(std::move(other.tasks)),
+    first_tick(other.first_tick),
+    last_tick(other.last_tick),
+    runner(std::move(other.runner))
+{
+  // The moved-from instance is left empty but usable, sharing the lock,
+  //  clock and executor
+  other.first_tick = true;
+  other.runner     = std::make_unique<Runner>();
+}
+
+Cron& Cron::operator=(Cron&& other)
+{
+  if (this != &other)
+  {
+    stop();
+
+    lockSptr     = other.lockSptr;
+    clockSptr    = other.clockSptr;
+    executorSptr = other.executorSptr;
+    tasks        = std::move(other.tasks);
+    first_tick   = other.first_tick;
+    last_tick    = other.last_tick;
+    runner       = std::move(other.runner);
+
+    other.first_tick = true;
+    other.runner     = std::make_unique<Runner>();
+  }
+
+  return *this;
+}
+
+bool Cron::add_schedule(std::string        name,
+                        const std::string& schedule,
+                        Task::TaskFunction work)
+{
+  TaskHandle handle;
+  return add_schedule(std::move(name), schedule, std::move(work), handle);
+}
+
+bool Cron::add_schedule(std::string        name,
+                        const std::string& schedule,
+                        Task::TaskFunction work,
+                        TaskHandle&        handle)
+{
+  handle = TaskHandle{};
+
+  auto cron{CronData::create(schedule)};
+  if (!cron) { return false; }
+
+  add_schedule(std::move(name), *cron, std::move(work), handle);
+
+  return true;
+}
+
+void Cron::add_schedule(std::string        name,
+                        const CronData&    schedule,
+                        Task::TaskFunction work)
+{
+  TaskHandle handle;
+  add_schedule(std::move(name), schedule, std::move(work), handle);
+}
+
+void Cron::add_schedule(std::string        name,
+                        const CronData&    schedule,
+                        Task::TaskFunction work,
+                        TaskHandle&        handle)
+{
+  add_task(std::move(name), schedule, nullptr, std::move(work), handle);
+}
+
+bool Cron::add_schedule(std::string                     name,
+                        const std::string&              schedule,
+                        std::shared_ptr<const TimeZone> zone,
+                        Task::TaskFunction              work)
+{
+  TaskHandle handle;
+  return add_schedule(
+    std::move(name), schedule, std::move(zone), std::move(work), handle);
+}
+
+bool Cron::add_schedule(std::string                     name,
+                        const std::string&              schedule,
+                        std::shared_ptr<const TimeZone> zone,
+                        Task::TaskFunction              work,
+                        TaskHandle&                     handle)
+{
+  handle = TaskHandle{};
+
+  auto cron{CronData::create(schedule)};
+  if (!cron || !zone) { return false; }
+
+  add_task(std::move(name), *cron, std::move(zone), std::move(work), handle);
+
+  return true;
+}
+
+void Cron::add_task(std::string                     name,
+                    const CronData&                 schedule,
+                    std::shared_ptr<const TimeZone> zone,
+                    Task::TaskFunction              work,
+                    TaskHandle&                     handle)
+{
+  handle = TaskHandle{};
+
+  tasks.lock_queue();
+  Task t{std::move(name),
+         CronSchedule::intern(schedule),
+         std::move(work),
+         std::move(zone)};
+  if (t.calculate_next(clockSptr->now())) { handle = tasks.push(std::move(t)); }
+  tasks.release_queue();
+
+  notify_schedule_changed();
+}
+
+bool Cron::reschedule(std::string_view name, const std::string& schedule)
+{
+  auto cron{CronData::create(schedule)};
+  if (!cron) { return false; }
+
+  const auto compiled = CronSchedule::intern(*cron);
+
+  tasks.lock_queue();
+  const auto now{clockSptr->now()};
+  const auto found =
+    tasks.update(name,
+                 [&compiled, now](Task& t)
+                 { return t.reschedule(compiled, now); });
+  tasks.release_queue();
+
+  if (found) { notify_schedule_changed(); }
+
+  return found;
+}
+
+bool Cron::set_overlap_policy(std::string_view name, OverlapPolicy policy)
+{
+  tasks.lock_queue();
+  const auto found = tasks.update(name,
+                                  [policy](Task& t)
+                                  {
+                                    t.set_overlap_policy(policy);
+                                    return true;
+                                  });
+  tasks.release_queue();
+
+  return found;
+}
+
+bool Cron::set_execution_key(std::string_view name, std::string key)
+{
+  tasks.lock_queue();
+  const auto found = tasks.update(name,
+                                  [&key](Task& t)
+                                  {
+                                    t.set_execution_key(std::move(key));
+                                    return true;
+                                  });
+  tasks.release_queue();
+
+  return found;
+}
+
+void Cron::clear_schedules()
+{
+  tasks.clear();
+  notify_schedule_changed();
+}
+
+void Cron::remove_schedule(std::string_view name)
+{
+  tasks.remove(name);
+  notify_schedule_changed();
+}
+
+bool Cron::remove_schedule(TaskHandle handle)
+{
+  const auto removed = tasks.remove(handle);
+  if (removed) { notify_schedule_changed(); }
+
+  return removed;
+}
+
+bool Cron::is_scheduled(TaskHandle handle) const
+{
+  tasks.lock_queue();
+  const auto found = tasks.find(handle) != nullptr;
+  tasks.release_queue();
+
+  return found;
+}
+
+std::optional<std::chrono::system_clock::duration> Cron::time_until_expiry(
+  TaskHandle handle) const
+{
+  std::optional<std::chrono::system_clock::duration> res;
+
+  tasks.lock_queue();
+  if (auto t = tasks.find(handle))
+  {
+    res = t->time_until_expiry(clockSptr->now());
+  }
+  tasks.release_queue();
+
+  return res;
+}
+
+size_t Cron::count() const
+{
+  return tasks.size();
+}
+
+// Tick is expected to be called at least once a second to prevent missing
+// schedules.
+size_t Cron::tick()
+{
+  return tick(clockSptr->now());
+}
+
+size_t Cron::tick(std::chrono::system_clock::time_point now)
+{
+  return tick(now, nullptr);
+}
+
+size_t Cron::tick(std::chrono::system_clock::time_point              now,
+                  const std::function<void(std::exception_ptr)>* on_error)
+{
+  tasks.lock_queue();
+  size_t res = 0;
+
+  drain_timer();
+
+  if (first_tick) { first_tick = false; }
+  else
+  {
+    constexpr auto one_second    = std::chrono::seconds{1};
+    constexpr auto three_hours   = std::chrono::hours{3};
+    const auto     second_now    = date::floor<std::chrono::seconds>(now);
+    const auto     second_last   = date::floor<std::chrono::seconds>(last_tick);
+    auto           diff          = second_now - second_last;
+    auto           absolute_diff = diff >= diff.zero() ? diff : -diff;
+    if (absolute_diff < one_second)
+    {
+      // Only allow time to flow once the clock has moved on to another
+      // second since the last tick, either forward or backward. Whole
+      // seconds are compared so that a tick right after a second boundary
+      // is never held back by one shortly after the previous boundary.
+      now = last_tick;
+    }
+    else if (absolute_diff >= three_hours)
+    {
+      // https://linux.die.net/man/8/cron
+      // Time changes of more than 3 hours are considered to be corrections to
+      // the clock or timezone, and the new time is used immediately.
+      // Occurrences skipped by a change forward are not run; the most recent
+      // one is looked up backwards from now and recorded on the task.
+      tasks.recalculate_all(now);
+    }
+    else
+    {
+      // Change of less than three hours
+
+      // If time has moved backwards: Since tasks are not rescheduled, they
+      // won't run before we're back at least the original point in time which
+      // prevents running tasks twice.
+
+      // If time has moved forward, tasks that would have run since last tick
+      // will be run.
+    }
+  }
+
+  last_tick = now;
+
+  // Tasks are ordered by their next schedule, so only expired tasks are
+  // visited, and the next schedule is calculated once per group of tasks
+  // sharing a schedule. Their callbacks are left to the executor, so the
+  // delay of each run is that of its dispatch.
+  using namespace std::chrono_literals;
+  auto& executor = *executorSptr;
+  res = tasks.expire(now,
+                     now + 1s,
+                     [&executor, now, on_error](Task& t)
+                     {
+                       auto run = t.dispatch(now);
+                       if (!run) { return; }
+
+                       if (!on_error)
+                       {
+                         executor.execute(std::move(*run));
+                         return;
+                       }
+
+                       // The task moves on to its next schedule regardless
+                       try
+                       {
+                         executor.execute(std::move(*run));
+                       }
+                       catch (...)
+                       {
+                         if (*on_error) { (*on_error)(std::current_exception()); }
+                       }
+                     });
+
+  arm_timer();
+  tasks.release_queue();
+  return res;
+}
+
+bool Cron::start(std::function<void(std::exception_ptr)> on_error)
+{
+  std::lock_guard<std::mutex> lock(runner->mutex);
+  if (runner->running) { return false; }
+
+  runner->on_error = std::move(on_error);
+  runner->running  = true;
+  runner->changed = false;
+  runner->thread  = std::thread([this]() { run(); });
+
+  return true;
+}
+
+void Cron::stop()
+{
+  {
+    std::lock_guard<std::mutex> lock(runner->mutex);
+    if (!runner->running) { return; }
+    runner->running = false;
+  }
+  runner->wake.notify_one();
+  runner->thread.join();
+}
+
+bool Cron::is_running() const
+{
+  std::lock_guard<std::mutex> lock(runner->mutex);
+  return runner->running;
+}
+
+void Cron::run()
+{
+  std::unique_lock<std::mutex> lock(runner->mutex);
+
+  while (runner->running)
+  {
+    runner->changed = false;
+    lock.unlock();
+
+    tick(clockSptr->now(), &runner->on_error);
+    const auto sleep = time_until_tick();
+
+    // Waiting for a point in system time ends the wait as soon as the system
+    //  clock is set past it
+    lock.lock();
+    runner->wake.wait_until(lock,
+                            std::chrono::system_clock::now() + sleep,
+                            [this]()
+                            { return runner->changed || !runner->running; });
+  }
+}
+
+std::chrono::system_clock::duration Cron::time_until_tick() const
+{
+  tasks.lock_queue();
+  const auto res = time_until_work(clockSptr->now());
+  tasks.release_queue();
+
+  return std::min<std::chrono::system_clock::duration>(res, max_sleep);
+}
+
+std::chrono::system_clock::duration Cron::time_until_work(
+  std::chrono::system_clock::time_point now) const
+{
+  using namespace std::chrono;
+
+  if (tasks.empty()) { return system_clock::duration::max(); }
+
+  auto res = tasks.top().time_until_expiry(now);
+
+  // Time does not flow for ticks within the second of the last one, see
+  //  tick(), so a task due then waits for the next second
+  const auto second = date::floor<seconds>(now);
+  if (res == res.zero() && !first_tick
+      && second == date::floor<seconds>(last_tick))
+  {
+    res = second + 1s - now;
+  }
+
+  return res;
+}
+
+void Cron::notify_schedule_changed()
+{
+  {
+    std::lock_guard<std::mutex> lock(runner->mutex);
+    runner->changed = true;
+  }
+  runner->wake.notify_one();
+
+  if (runner->timer_fd >= 0)
+  {
+    tasks.lock_queue();
+    arm_timer();
+    tasks.release_queue();
+  }
+}
+
+int Cron::get_timer_fd()
+{
+#ifdef __linux__
+  {
+    std::lock_guard<std::mutex> lock(runner->mutex);
+    if (runner->timer_fd < 0)
+    {
+      runner->timer_fd =
+        timerfd_create(CLOCK_REALTIME, TFD_NONBLOCK | TFD_CLOEXEC);
+    }
+  }
+
+  tasks.lock_queue();
+  arm_timer();
+  tasks.release_queue();
+
+  return runner->timer_fd;
+#else
+  return -1;
+#endif
+}
+
+void Cron::arm_timer()
+{
+#ifdef __linux__
+  const int fd = runner->timer_fd;
+  if (fd < 0) { return; }
+
+  using namespace std::chrono;
+
+  // Disarmed while there are no tasks
+  itimerspec spec{};
+
+  const auto until = time_until_work(clockSptr->now());
+  if (until != system_clock::duration::max())
+  {
+    // The clock of the instance may show local time, so the timer is set
+    //  relative to the current system time
+    const auto when =
+      system_clock::now() + std::min<system_clock::duration>(until, max_timer);
+    const auto secs  = date::floor<seconds>(when);
+    const auto nanos = duration_cast<nanoseconds>(when - secs);
+
+    spec.it_value.tv_sec  = static_cast<time_t>(secs.time_since_epoch().count());
+    spec.it_value.tv_nsec = static_cast<long>(nanos.count());
+  }
+
+  // Setting the system clock cancels the timer and makes it readable, so
+  //  that tick() sees the change
+  timerfd_settime(
+    fd, TFD_TIMER_ABSTIME | TFD_TIMER_CANCEL_ON_SET, &spec, nullptr);
+#endif
+}
+
+void Cron::drain_timer()
+{
+#ifdef __linux__
+  const int fd = runner->timer_fd;
+  if (fd < 0) { return; }
+
+  // Fails with EAGAIN if the timer has not expired, or ECANCELED after the
+  //  system clock was set; either way it is armed again by tick()
+  uint64_t expirations = 0;
+  [[maybe_unused]] auto res = read(fd, &expirations, sizeof(expirations));
+#endif
+}
+
+std::chrono::system_clock::duration Cron::time_until_next() const
+{
+  return (tasks.empty() ? std::chrono::system_clock::duration::max()
+                        : tasks.top().time_until_expiry(clockSptr->now()));
+}
+
+ICronClock& Cron::get_clock() const
+{
+  return *clockSptr;
+}
+
+void Cron::recalculate_schedule()
+{
+  tasks.lock_queue();
+  const auto now{clockSptr->now()};
+  using namespace std::chrono_literals;
+  // Ensure that next schedule is in the future
+  tasks.recalculate_all(now + 1s);
+  tasks.release_queue();
+
+  notify_schedule_changed();
+}
+
+void Cron::get_time_until_expiry_for_tasks(
+  std::vector<std::tuple<std::string, std::chrono::system_clock::duration> >&
+    status) const
+{
+  const auto& now{clockSptr->now()};
+  status.clear();
+
+  tasks.lock_queue();
+  status.reserve(tasks.size());
+  for (auto t : tasks.sorted())
+  {
+    status.emplace_back(t->get_name(), t->time_until_expiry(now));
+  }
+  tasks.release_queue();
+}
+
+uint64_t Cron::count_occurrences(
+  std::chrono::system_clock::time_point from,
+  std::chrono::system_clock::time_point until) const
+{
+  uint64_t res = 0;
+
+  tasks.lock_queue();
+  const auto counts = count_by_schedule(from, until);
+  tasks.for_each([&res, &counts](const Task& t)
+                 {
+                   res += counts.at(std::make_pair(t.get_schedule().get(),
+                                                   t.get_time_zone().get()));
+                 });
+  tasks.release_queue();
+
+  return res;
+}
+
+void Cron::get_occurrence_counts_for_tasks(
+  std::chrono::system_clock::time_point           from,
+  std::chrono::system_clock::time_point           until,
+  std::vector<std::tuple<std::string, uint64_t>>& counts) const
+{
+  counts.clear();
+
+  tasks.lock_queue();
+  const auto by_schedule = count_by_schedule(from, until);
+  counts.reserve(tasks.size());
+  for (auto t : tasks.sorted())
+  {
+    counts.emplace_back(t->get_name(),
+                        by_schedule.at(std::make_pair(
+                          t->get_schedule().get(), t->get_time_zone().get())));
+  }
+  tasks.release_queue();
+}
+
+std::map<std::pair<const CronSchedule*, const TimeZone*>, uint64_t>
+Cron::count_by_schedule(std::chrono::system_clock::time_point from,
+                        std::chrono::system_clock::time_point until) const
+{
+  // Tasks share interned schedules, so each schedule is counted once per
+  //  time zone. Tasks with a time zone are counted in its civil time, by the
+  //  same rules as they run.
+  std::map<std::pair<const CronSchedule*, const TimeZone*>, uint64_t> res;
+  tasks.for_each(
+    [&res, from, until](const Task& t)
+    {
+      const auto& schedule = *t.get_schedule();
+      const auto* zone     = t.get_time_zone().get();
+      const auto  key      = std::make_pair(&schedule, zone);
+      if (res.find(key) == res.end())
+      {
+        res.emplace(key,
+                    zone ? zone->count_between(schedule, from, until)
+                         : schedule.count_between(from, until));
+      }
+    });
+
+  return res;
+}
+
+std::ostream& operator<<(std::ostream& stream, const Cron& c)
+{
+  auto now = c.clockSptr->now();
+  for (auto t : c.tasks.sorted()) { stream << t->get_status(now) << '\n'; }
+
+  return stream;
+}
+}  // namespace libcron
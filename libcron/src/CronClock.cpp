@@ -8,10 +8,28 @@
 #  include <Windows.h>
 #endif
 
+#include <ctime>
+
 using namespace std::chrono;
 
 namespace libcron
 {
+namespace
+{
+std::chrono::system_clock::time_point coarse_now()
+{
+#ifdef CLOCK_REALTIME_COARSE
+  timespec ts{};
+  if (clock_gettime(CLOCK_REALTIME_COARSE, &ts) == 0)
+  {
+    return system_clock::time_point{duration_cast<system_clock::duration>(
+      seconds{ts.tv_sec} + nanoseconds{ts.tv_nsec})};
+  }
+#endif
+  return system_clock::now();
+}
+}  // namespace
+
 // UTCClock
 std::chrono::system_clock::time_point UTCClock::now() const
 {
@@ -24,7 +42,37 @@ std::chrono::seconds UTCClock::utc_offset(
   return 0s;
 }
 
+// CoarseUTCClock
+std::chrono::system_clock::time_point CoarseUTCClock::now() const
+{
+  return coarse_now();
+}
+
 // LocalClock
+LocalClock::LocalClock(const LocalClock& other) : ICronClock(other)
+{
+  *this = other;
+}
+
+LocalClock& LocalClock::operator=(const LocalClock& other)
+{
+  // A cache that is being updated is not copied; the copy then starts empty
+  const auto before = other.sequence.load(std::memory_order_acquire);
+  const auto from   = other.valid_from.load(std::memory_order_relaxed);
+  const auto until  = other.valid_until.load(std::memory_order_relaxed);
+  const auto offset = other.cached_offset.load(std::memory_order_relaxed);
+
+  std::atomic_thread_fence(std::memory_order_acquire);
+  if ((before & 1) == 0
+      && other.sequence.load(std::memory_order_relaxed) == before)
+  {
+    store_cache(from, until, offset);
+  }
+  else { store_cache(0, 0, 0); }
+
+  return *this;
+}
+
 std::chrono::system_clock::time_point LocalClock::now() const
 {
   const auto& now{std::chrono::system_clock::now()};
@@ -33,6 +81,77 @@ std::chrono::system_clock::time_point LocalClock::now() const
 
 std::chrono::seconds LocalClock::utc_offset(
   std::chrono::system_clock::time_point now) const
+{
+  const auto time = duration_cast<seconds>(now.time_since_epoch()).count();
+
+  const auto before = sequence.load(std::memory_order_acquire);
+  if ((before & 1) == 0)
+  {
+    const auto from   = valid_from.load(std::memory_order_relaxed);
+    const auto until  = valid_until.load(std::memory_order_relaxed);
+    const auto offset = cached_offset.load(std::memory_order_relaxed);
+
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (sequence.load(std::memory_order_relaxed) == before && time >= from
+        && time < until)
+    {
+      return seconds{offset};
+    }
+  }
+
+  return update_cache(now);
+}
+
+std::chrono::seconds LocalClock::update_cache(
+  std::chrono::system_clock::time_point time) const
+{
+  // Assume that the offset changes at most once a day. If it is the same a
+  //  day later, the window covers that day; otherwise the change is searched
+  //  for to the second and ends the window.
+  const auto start  = floor<seconds>(time);
+  const auto offset = calculate_utc_offset(start);
+
+  auto end = start + hours{24};
+  if (calculate_utc_offset(end) != offset)
+  {
+    auto unchanged = start;
+    while (end - unchanged > 1s)
+    {
+      const auto middle = unchanged + (end - unchanged) / 2;
+      if (calculate_utc_offset(middle) == offset) { unchanged = middle; }
+      else { end = middle; }
+    }
+  }
+
+  store_cache(start.time_since_epoch().count(),
+              end.time_since_epoch().count(),
+              offset.count());
+
+  return offset;
+}
+
+void LocalClock::store_cache(int64_t from, int64_t until, int64_t offset) const
+{
+  // Writers do not wait for each other: one that finds an update in progress
+  //  leaves the cache to it, and readers calculate the offset themselves
+  //  until it is done
+  auto current = sequence.load(std::memory_order_relaxed);
+  if ((current & 1) != 0
+      || !sequence.compare_exchange_strong(
+        current, current + 1, std::memory_order_relaxed))
+  {
+    return;
+  }
+
+  std::atomic_thread_fence(std::memory_order_release);
+  valid_from.store(from, std::memory_order_relaxed);
+  valid_until.store(until, std::memory_order_relaxed);
+  cached_offset.store(offset, std::memory_order_relaxed);
+  sequence.store(current + 2, std::memory_order_release);
+}
+
+std::chrono::seconds LocalClock::calculate_utc_offset(
+  std::chrono::system_clock::time_point now)
 {
 #ifdef WIN32
   (void)now;
@@ -56,4 +175,11 @@ std::chrono::seconds LocalClock::utc_offset(
 #endif
   return offset;
 }
+
+// CoarseLocalClock
+std::chrono::system_clock::time_point CoarseLocalClock::now() const
+{
+  const auto& now{coarse_now()};
+  return now + utc_offset(now);
+}
 }  // namespace libcron
@@ -1,59 +1,85 @@
 #include "libcron/CronData.h"
 
+#include "libcron/CronDataCache.h"
+
 #include <date/date.h>
-#include <stdexcept>
+#include <iterator>
 
 using namespace date;
 
 namespace libcron
 {
-const constexpr Months CronData::months_with_31[NUMBER_OF_LONG_MONTHS] = {
-  Months::January,
-  Months::March,
-  Months::May,
-  Months::July,
-  Months::August,
-  Months::October,
-  Months::December};
-
-const std::vector<std::string> CronData::month_names{"JAN",
-                                                     "FEB",
-                                                     "MAR",
-                                                     "APR",
-                                                     "MAY",
-                                                     "JUN",
-                                                     "JUL",
-                                                     "AUG",
-                                                     "SEP",
-                                                     "OCT",
-                                                     "NOV",
-                                                     "DEC"};
-const std::vector<std::string> CronData::day_names{
-  "SUN", "MON", "TUE", "WED", "THU", "FRI", "SAT"};
-std::unordered_map<std::string, CronData> CronData::cache{};
-
-std::optional<CronData> CronData::create(const std::string& cron_expression)
+// The compiled representation is a handful of bitmasks, cheap to copy around.
+static_assert(std::is_trivially_copyable<CronData>::value,
+              "CronData should be trivially copyable");
+
+std::optional<CronData> CronData::create(std::string_view cron_expression)
 {
-  const auto& found{cache.find(cron_expression)};
+  auto& shared = cache();
 
-  if (found == cache.end())
+  auto found{shared.find(cron_expression)};
+  if (!found)
   {
-    try
-    {
-      CronData c(cron_expression);
-      cache.insert({cron_expression, c});
-      return c;
-    }
-    catch (const std::invalid_argument& e)
-    {
-      return {};
-    }
+    found = create_uncached(cron_expression);
+    if (found) { shared.insert(cron_expression, *found); }
   }
 
-  return found->second;
+  return found;
+}
+
+std::optional<CronData> CronData::create_uncached(
+  std::string_view cron_expression)
+{
+  CronData c;
+  if (!c.parse(cron_expression)) { return {}; }
+
+  return c;
+}
+
+bool CronData::operator==(const CronData& other) const
+{
+  return seconds == other.seconds && minutes == other.minutes
+         && hours == other.hours && day_of_month == other.day_of_month
+         && months == other.months && day_of_week == other.day_of_week;
+}
+
+size_t CronData::hash() const
+{
+  // The fields take 60 + 60 + 24 + 31 + 12 + 7 bits; fold them into two words
+  const uint64_t low = uint64_t{seconds.bits()}
+                       ^ (uint64_t{hours.bits()} << 40)
+                       ^ (uint64_t{months.bits()} << 20);
+  const uint64_t high = uint64_t{minutes.bits()}
+                        ^ (uint64_t{day_of_month.bits()} << 30)
+                        ^ (uint64_t{day_of_week.bits()} << 57);
+
+  return std::hash<uint64_t>{}(low ^ (high * 0x9E3779B97F4A7C15ull));
+}
+
+CronDataCache& CronData::cache()
+{
+  static CronDataCache instance;
+  return instance;
+}
+
+std::optional<CronData> CronData::create_using_regex(
+  const std::string& cron_expression)
+{
+  CronData c;
+  if (!c.parse_using_regex(cron_expression)) { return {}; }
+
+  return c;
+}
+
+bool CronData::parse(std::string_view cron_expression)
+{
+  detail::DynamicString expanded;
+  detail::DynamicString part_buffer;
+
+  return parse(cron_expression, expanded, part_buffer);
 }
 
-CronData::CronData(const std::string& cron_expression)
+bool CronData::parse_using_regex(const std::string& cron_expression)
 {
   // First, check for "convenience scheduling" using @yearly, @annually,
   // @monthly, @weekly, @daily or @hourly.
@@ -81,15 +107,11 @@ CronData::CronData(const std::string& cron_expression)
     valid &= validate_numeric<DayOfMonth>(match[4], day_of_month);
     valid &= validate_literal<Months>(match[5], months, month_names);
     valid &= validate_literal<DayOfWeek>(match[6], day_of_week, day_names);
-    valid &= check_dom_vs_dow(match[4], match[6]);
+    valid &= check_dom_vs_dow(match[4].str(), match[6].str());
     valid &= validate_date_vs_months();
   }
 
-  if (!valid)
-  {
-    throw std::invalid_argument(
-      "CronData(): cron_expression failed validation");
-  }
+  return valid;
 }
 
 std::vector<std::string> CronData::split(const std::string& s, char token)
@@ -116,58 +138,4 @@ bool CronData::is_number(const std::string& s)
                       s.end(),
                       [](char c) { return !std::isdigit(c); }) == s.end();
 }
-
-bool CronData::is_between(int32_t value, int32_t low_limit, int32_t high_limt)
-{
-  return value >= low_limit && value <= high_limt;
-}
-
-bool CronData::validate_date_vs_months() const
-{
-  bool res = true;
-
-  // Verify that the available dates are possible based on the given months
-  if (months.size() == 1 && months.find(static_cast<Months>(2)) != months.end())
-  {
-    // Only february allowed, make sure that the allowed date(s) includes 29 and
-    // below.
-    res = has_any_in_range(day_of_month, 1, 29);
-  }
-
-  if (res)
-  {
-    // Make sure that if the days contains only 31, at least one month allows
-    // that date.
-    if (day_of_month.size() == 1 &&
-        day_of_month.find(DayOfMonth::Last) != day_of_month.end())
-    {
-      res = false;
-
-      for (size_t i = 0; !res && i < NUMBER_OF_LONG_MONTHS; ++i)
-      {
-        res = months.find(months_with_31[i]) != months.end();
-      }
-    }
-  }
-
-  return res;
-}
-
-bool CronData::check_dom_vs_dow(const std::string& dom,
-                                const std::string& dow) const
-{
-  // Day of month and day of week are mutually exclusive so one of them must at
-  // always be ignored using the '?'-character unless one field already is
-  // something other than '*'.
-  //
-  // Since we treat an ignored field as allowing the full range, we're OK with
-  // both being flagged as ignored. To make it explicit to the user of the
-  // library, we do however require the use of
-  // '?' as the ignore flag, although it is functionally equivalent to '*'.
-
-  auto check = [](const std::string& l, std::string r)
-  { return l == "*" && (r != "*" || r == "?"); };
-
-  return (dom == "?" || dow == "?") || check(dom, dow) || check(dow, dom);
-}
 }  // namespace libcron
@@ -0,0 +1,146 @@
+#include "libcron/CronDataCache.h"
+
+#include <functional>
+
+namespace libcron
+{
+namespace
+{
+size_t per_shard(size_t capacity, size_t shards)
+{
+  // Round up, and keep at least one entry per shard
+  return std::max<size_t>(1, (capacity + shards - 1) / shards);
+}
+}  // namespace
+
+CronDataCache::CronDataCache(size_t capacity)
+  : shard_capacity(per_shard(capacity, shard_count))
+{
+}
+
+std::optional<CronData> CronDataCache::find(std::string_view cron_expression)
+{
+  auto&                       shard = shard_for(cron_expression);
+  std::lock_guard<std::mutex> lock(shard.mutex);
+
+  auto found = shard.index.find(cron_expression);
+  if (found == shard.index.end())
+  {
+    misses.fetch_add(1, std::memory_order_relaxed);
+    return {};
+  }
+
+  hits.fetch_add(1, std::memory_order_relaxed);
+  shard.entries.splice(shard.entries.begin(), shard.entries, found->second);
+
+  return found->second->second;
+}
+
+void CronDataCache::insert(std::string_view cron_expression,
+                           const CronData&  data)
+{
+  auto&                       shard = shard_for(cron_expression);
+  std::lock_guard<std::mutex> lock(shard.mutex);
+
+  auto found = shard.index.find(cron_expression);
+  if (found != shard.index.end())
+  {
+    found->second->second = data;
+    shard.entries.splice(shard.entries.begin(), shard.entries, found->second);
+    return;
+  }
+
+  shard.entries.emplace_front(std::string{cron_expression}, data);
+  shard.index.emplace(shard.entries.front().first, shard.entries.begin());
+
+  trim(shard, shard_capacity.load(std::memory_order_relaxed));
+}
+
+size_t CronDataCache::prewarm(
+  const std::vector<std::string_view>& cron_expressions)
+{
+  size_t valid = 0;
+
+  for (auto expression : cron_expressions)
+  {
+    if (auto data = CronData::create_uncached(expression))
+    {
+      insert(expression, *data);
+      ++valid;
+    }
+  }
+
+  return valid;
+}
+
+void CronDataCache::clear()
+{
+  for (auto& shard : shards)
+  {
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    shard.index.clear();
+    shard.entries.clear();
+  }
+}
+
+void CronDataCache::set_capacity(size_t capacity)
+{
+  const auto new_capacity = per_shard(capacity, shard_count);
+  shard_capacity.store(new_capacity, std::memory_order_relaxed);
+
+  for (auto& shard : shards)
+  {
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    trim(shard, new_capacity);
+  }
+}
+
+size_t CronDataCache::capacity() const
+{
+  return shard_capacity.load(std::memory_order_relaxed) * shard_count;
+}
+
+size_t CronDataCache::size() const
+{
+  size_t res = 0;
+
+  for (const auto& shard : shards)
+  {
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    res += shard.entries.size();
+  }
+
+  return res;
+}
+
+CronDataCacheStats CronDataCache::stats() const
+{
+  CronDataCacheStats res;
+  res.hits      = hits.load(std::memory_order_relaxed);
+  res.misses    = misses.load(std::memory_order_relaxed);
+  res.evictions = evictions.load(std::memory_order_relaxed);
+  return res;
+}
+
+void CronDataCache::reset_stats()
+{
+  hits.store(0, std::memory_order_relaxed);
+  misses.store(0, std::memory_order_relaxed);
+  evictions.store(0, std::memory_order_relaxed);
+}
+
+CronDataCache::Shard& CronDataCache::shard_for(std::string_view cron_expression)
+{
+  return shards[std::hash<std::string_view>{}(cron_expression) % shard_count];
+}
+
+void CronDataCache::trim(Shard& shard, size_t max_entries)
+{
+  while (shard.entries.size() > max_entries)
+  {
+    shard.index.erase(shard.entries.back().first);
+    shard.entries.pop_back();
+    evictions.fetch_add(1, std::memory_order_relaxed);
+  }
+}
+}  // namespace libcron
@@ -0,0 +1,204 @@
+#include "libcron/CronExecutor.h"
+
+#include <algorithm>
+#include <functional>
+
+namespace libcron
+{
+ThreadPoolExecutor::ThreadPoolExecutor(size_t thread_count)
+{
+  thread_count = std::max<size_t>(1, thread_count);
+  threads.reserve(thread_count);
+  for (size_t i = 0; i < thread_count; ++i)
+  {
+    threads.emplace_back([this]() { work(); });
+  }
+}
+
+ThreadPoolExecutor::~ThreadPoolExecutor()
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping = true;
+  }
+  available.notify_all();
+
+  for (auto& thread : threads) { thread.join(); }
+}
+
+void ThreadPoolExecutor::execute(TaskRun run)
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    queue.push_back(std::move(run));
+  }
+  available.notify_one();
+}
+
+void ThreadPoolExecutor::wait_idle()
+{
+  std::unique_lock<std::mutex> lock(mutex);
+  idle.wait(lock, [this]() { return queue.empty() && busy == 0; });
+}
+
+void ThreadPoolExecutor::work()
+{
+  std::unique_lock<std::mutex> lock(mutex);
+
+  for (;;)
+  {
+    available.wait(lock, [this]() { return stopping || !queue.empty(); });
+
+    // Queued runs are completed before stopping
+    if (queue.empty()) { return; }
+
+    auto run = std::move(queue.front());
+    queue.pop_front();
+    ++busy;
+
+    lock.unlock();
+    run.run();
+    lock.lock();
+
+    if (--busy == 0 && queue.empty()) { idle.notify_all(); }
+  }
+}
+
+WorkStealingExecutor::WorkStealingExecutor(size_t thread_count)
+{
+  thread_count = std::max<size_t>(1, thread_count);
+
+  workers.reserve(thread_count);
+  for (size_t i = 0; i < thread_count; ++i)
+  {
+    workers.push_back(std::make_unique<Worker>());
+  }
+
+  threads.reserve(thread_count);
+  for (size_t i = 0; i < thread_count; ++i)
+  {
+    threads.emplace_back([this, i]() { work(i); });
+  }
+}
+
+WorkStealingExecutor::~WorkStealingExecutor()
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping = true;
+  }
+  available.notify_all();
+
+  for (auto& thread : threads) { thread.join(); }
+}
+
+void WorkStealingExecutor::execute(TaskRun run)
+{
+  unfinished.fetch_add(1);
+
+  auto& worker = *workers[next_worker.fetch_add(1) % workers.size()];
+  {
+    std::lock_guard<std::mutex> lock(worker.mutex);
+    worker.queue.push_back(std::move(run));
+  }
+
+  // A worker about to sleep counts itself as sleeping before checking queued,
+  //  so either it sees this run or it is woken here
+  queued.fetch_add(1);
+  if (sleeping.load() > 0)
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    available.notify_one();
+  }
+}
+
+void WorkStealingExecutor::wait_idle()
+{
+  std::unique_lock<std::mutex> lock(mutex);
+  idle.wait(lock, [this]() { return unfinished.load() == 0; });
+}
+
+std::optional<TaskRun> WorkStealingExecutor::take(size_t index)
+{
+  std::optional<TaskRun> res;
+
+  for (size_t i = 0; i < workers.size() && !res; ++i)
+  {
+    auto&                       worker = *workers[(index + i) % workers.size()];
+    std::lock_guard<std::mutex> lock(worker.mutex);
+    if (worker.queue.empty()) { continue; }
+
+    if (i == 0)
+    {
+      res.emplace(std::move(worker.queue.front()));
+      worker.queue.pop_front();
+    }
+    else
+    {
+      res.emplace(std::move(worker.queue.back()));
+      worker.queue.pop_back();
+    }
+  }
+
+  if (res) { queued.fetch_sub(1); }
+
+  return res;
+}
+
+void WorkStealingExecutor::work(size_t index)
+{
+  for (;;)
+  {
+    if (auto run = take(index))
+    {
+      run->run();
+
+      if (unfinished.fetch_sub(1) == 1)
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        idle.notify_all();
+      }
+      continue;
+    }
+
+    std::unique_lock<std::mutex> lock(mutex);
+    sleeping.fetch_add(1);
+    available.wait(lock,
+                   [this]() { return stopping || queued.load() > 0; });
+    sleeping.fetch_sub(1);
+
+    // Queued runs are completed before stopping
+    if (stopping && queued.load() <= 0) { return; }
+  }
+}
+
+KeyedExecutor::KeyedExecutor(size_t lane_count)
+{
+  lane_count = std::max<size_t>(1, lane_count);
+
+  lanes.reserve(lane_count);
+  for (size_t i = 0; i < lane_count; ++i)
+  {
+    lanes.push_back(std::make_unique<ThreadPoolExecutor>(1));
+  }
+}
+
+void KeyedExecutor::execute(TaskRun run)
+{
+  const auto key_hash = run.get_key_hash();
+  const auto lane =
+    key_hash ? *key_hash % lanes.size() : next_lane.fetch_add(1) % lanes.size();
+
+  lanes[lane]->execute(std::move(run));
+}
+
+void KeyedExecutor::wait_idle()
+{
+  for (auto& lane : lanes) { lane->wait_idle(); }
+}
+
+size_t KeyedExecutor::lane_of(const std::string& key) const
+{
+  return std::hash<std::string>{}(key) % lanes.size();
+}
+}  // namespace libcron
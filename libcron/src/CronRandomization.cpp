@@ -85,7 +85,7 @@ std::tuple<bool, std::string> CronRandomization::parse(
       get_random_in_range<Months>(all_sections[5].str(), selected_value);
     res &= month.first;
 
-    std::set<Months> month_range{};
+    CronField<Months> month_range{};
 
     if (selected_value == -1)
     {
@@ -113,7 +113,7 @@ std::tuple<bool, std::string> CronRandomization::parse(
 }
 
 std::pair<int, int> CronRandomization::day_limiter(
-  const std::set<Months>& months)
+  const CronField<Months>& months)
 {
   int max = CronData::value_of(DayOfMonth::Last);
 
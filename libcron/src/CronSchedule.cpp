@@ -1,105 +1,522 @@
 #include "libcron/CronSchedule.h"
 
+#include <algorithm>
+#include <mutex>
 #include <tuple>
+#include <unordered_map>
 
 using namespace std::chrono;
 using namespace date;
 
 namespace libcron
 {
+namespace
+{
+struct CronDataHash
+{
+  size_t operator()(const CronData& data) const { return data.hash(); }
+};
+
+// Interned schedules. Entries are weak so that a schedule is released with
+//  the last task using it; expired entries are dropped whenever the table has
+//  doubled since the last sweep.
+struct InternTable
+{
+  std::mutex mutex;
+  std::unordered_map<CronData, std::weak_ptr<const CronSchedule>, CronDataHash>
+         schedules;
+  size_t sweep_at = 64;
+
+  void sweep()
+  {
+    for (auto it = schedules.begin(); it != schedules.end();)
+    {
+      if (it->second.expired()) { it = schedules.erase(it); }
+      else { ++it; }
+    }
+
+    sweep_at = std::max<size_t>(64, 2 * schedules.size());
+  }
+};
+
+InternTable& intern_table()
+{
+  static InternTable table;
+  return table;
+}
+}  // namespace
+
+std::shared_ptr<const CronSchedule> CronSchedule::intern(const CronData& data)
+{
+  auto&                       table = intern_table();
+  std::lock_guard<std::mutex> lock(table.mutex);
+
+  auto& entry = table.schedules.try_emplace(data).first->second;
+  auto  res   = entry.lock();
+
+  if (!res)
+  {
+    res   = std::make_shared<const CronSchedule>(data);
+    entry = res;
+
+    if (table.schedules.size() >= table.sweep_at) { table.sweep(); }
+  }
+
+  return res;
+}
+
+size_t CronSchedule::interned_count()
+{
+  auto&                       table = intern_table();
+  std::lock_guard<std::mutex> lock(table.mutex);
+
+  size_t res = 0;
+  for (const auto& entry : table.schedules)
+  {
+    if (!entry.second.expired()) { ++res; }
+  }
+
+  return res;
+}
 
 std::tuple<bool, std::chrono::system_clock::time_point>
 CronSchedule::calculate_from(
   const std::chrono::system_clock::time_point& from) const
 {
-  auto curr = from;
+  uint32_t iterations = 0;
+  return calculate_from(from, iterations);
+}
+
+std::tuple<bool, std::chrono::system_clock::time_point>
+CronSchedule::calculate_from(const std::chrono::system_clock::time_point& from,
+                             uint32_t& iterations) const
+{
+  // Discard fraction seconds in the calculated schedule time
+  //  that may leftover from the argument `from`, which in turn comes from
+  //  `now()`.
+  // Fraction seconds will potentially make the task be triggered more than 1
+  // second late
+  //  if the `tick()` within the same second is earlier than schedule time,
+  //  in that the task will not trigger until the next `tick()` next second.
+  // By discarding fraction seconds in the scheduled time,
+  //  the `tick()` within the same second will never be earlier than schedule
+  //  time, and the task will trigger in that `tick()`.
+  CalendarCursor c{from};
+
+  if (!find_next(c, iterations)) { return std::make_tuple(false, from); }
+
+  return std::make_tuple(true, c.to_time_point());
+}
+
+bool CronSchedule::find_next(CalendarCursor& c, uint32_t& iterations) const
+{
+  auto& y  = c.year;
+  auto& mo = c.month;
+  auto& d  = c.day;
+  auto& h  = c.hour;
+  auto& mi = c.minute;
+  auto& s  = c.second;
 
-  bool done           = false;
-  auto max_iterations = std::numeric_limits<uint16_t>::max();
+  const auto last_year = y + max_years_ahead;
+  bool       done      = false;
+  iterations           = 0;
 
-  while (!done && --max_iterations > 0)
+  // Move each field to its next allowed value, from the largest to the
+  // smallest one. When a field has no allowed value left, carry into the next
+  // larger field, reset the smaller ones and start over.
+  while (!done && y <= last_year)
   {
-    bool           date_changed = false;
-    year_month_day ymd          = date::floor<days>(curr);
-
-    // Add months until one of the allowed days are found, or stay at the
-    // current one.
-    if (data.get_months().find(static_cast<Months>(unsigned(ymd.month()))) ==
-        data.get_months().end())
-    {
-      auto     next_month = ymd + months{1};
-      sys_days s          = next_month.year() / next_month.month() / 1;
-      curr                = s;
-      date_changed        = true;
-    }
-    // If all days are allowed (or the field is ignored via '?'), then the 'day
-    // of week' takes precedence.
-    else if (data.get_day_of_month().size() !=
-             CronData::value_of(DayOfMonth::Last))
-    {
-      // Add days until one of the allowed days are found, or stay at the
-      // current one.
-      if (data.get_day_of_month().find(static_cast<DayOfMonth>(
-            unsigned(ymd.day()))) == data.get_day_of_month().end())
-      {
-        sys_days s = ymd;
-        curr       = s;
-        curr += days{1};
-        date_changed = true;
-      }
+    ++iterations;
+
+    auto next_month = data.get_months().next(static_cast<int>(mo));
+    if (next_month < 0)
+    {
+      ++y;
+      mo = 1;
+      d  = 1;
+      h = mi = s = 0;
+      continue;
+    }
+
+    if (static_cast<unsigned>(next_month) != mo)
+    {
+      mo = static_cast<unsigned>(next_month);
+      d  = 1;
+      h = mi = s = 0;
     }
-    else
+
+    auto next_day_of_month = next_day(c);
+    if (next_day_of_month < 0)
     {
-      // Add days until the current weekday is one of the allowed weekdays
-      year_month_weekday ymw = date::floor<days>(curr);
+      ++mo;
+      d = 1;
+      h = mi = s = 0;
+      continue;
+    }
 
-      if (data.get_day_of_week().find(static_cast<DayOfWeek>(
-            ymw.weekday().c_encoding())) == data.get_day_of_week().end())
-      {
-        sys_days s = ymd;
-        curr       = s;
-        curr += days{1};
-        date_changed = true;
-      }
+    if (static_cast<unsigned>(next_day_of_month) != d)
+    {
+      d = static_cast<unsigned>(next_day_of_month);
+      h = mi = s = 0;
     }
 
-    if (!date_changed)
+    auto next_hour = data.get_hours().next(h);
+    if (next_hour < 0)
     {
-      auto date_time = to_calendar_time(curr);
-      if (data.get_hours().find(static_cast<Hours>(date_time.hour)) ==
-          data.get_hours().end())
-      {
-        curr += hours{1};
-        curr -= minutes{date_time.min};
-        curr -= seconds{date_time.sec};
-      }
-      else if (data.get_minutes().find(static_cast<Minutes>(date_time.min)) ==
-               data.get_minutes().end())
+      ++d;
+      h = mi = s = 0;
+      continue;
+    }
+
+    if (next_hour != h)
+    {
+      h  = next_hour;
+      mi = s = 0;
+    }
+
+    auto next_minute = data.get_minutes().next(mi);
+    if (next_minute < 0)
+    {
+      ++h;
+      mi = s = 0;
+      continue;
+    }
+
+    if (next_minute != mi)
+    {
+      mi = next_minute;
+      s  = 0;
+    }
+
+    auto next_second = data.get_seconds().next(s);
+    if (next_second < 0)
+    {
+      ++mi;
+      s = 0;
+      continue;
+    }
+
+    s    = next_second;
+    done = true;
+  }
+
+  return done;
+}
+
+std::tuple<bool, std::chrono::system_clock::time_point>
+CronSchedule::calculate_before(
+  const std::chrono::system_clock::time_point& from) const
+{
+  uint32_t iterations = 0;
+  return calculate_before(from, iterations);
+}
+
+std::tuple<bool, std::chrono::system_clock::time_point>
+CronSchedule::calculate_before(
+  const std::chrono::system_clock::time_point& from,
+  uint32_t&                                    iterations) const
+{
+  // Flooring to the second keeps an occurrence within the current second
+  CalendarCursor c{from};
+
+  if (!find_previous(c, iterations)) { return std::make_tuple(false, from); }
+
+  return std::make_tuple(true, c.to_time_point());
+}
+
+bool CronSchedule::find_previous(CalendarCursor& c, uint32_t& iterations) const
+{
+  auto& y  = c.year;
+  auto& mo = c.month;
+  auto& d  = c.day;
+  auto& h  = c.hour;
+  auto& mi = c.minute;
+  auto& s  = c.second;
+
+  const auto first_year = y - max_years_ahead;
+  bool       done       = false;
+  iterations            = 0;
+
+  // Mirror image of find_next(): move each field to its previous allowed
+  // value, from the largest to the smallest one. When a field has no allowed
+  // value left, borrow from the next larger field and set the smaller ones to
+  // their largest value.
+  constexpr unsigned last_day = CronData::value_of(DayOfMonth::Last);
+
+  while (!done && y >= first_year)
+  {
+    ++iterations;
+
+    auto previous_month = data.get_months().prev(static_cast<int>(mo));
+    if (previous_month < 0)
+    {
+      --y;
+      mo = 12;
+      d  = last_day;
+      h  = 23;
+      mi = s = 59;
+      continue;
+    }
+
+    if (static_cast<unsigned>(previous_month) != mo)
+    {
+      mo = static_cast<unsigned>(previous_month);
+      d  = last_day;
+      h  = 23;
+      mi = s = 59;
+    }
+
+    auto previous_day_of_month = previous_day(c);
+    if (previous_day_of_month < 0)
+    {
+      --mo;
+      d  = last_day;
+      h  = 23;
+      mi = s = 59;
+      continue;
+    }
+
+    if (static_cast<unsigned>(previous_day_of_month) != d)
+    {
+      d  = static_cast<unsigned>(previous_day_of_month);
+      h  = 23;
+      mi = s = 59;
+    }
+
+    auto previous_hour = data.get_hours().prev(h);
+    if (previous_hour < 0)
+    {
+      --d;
+      h  = 23;
+      mi = s = 59;
+      continue;
+    }
+
+    if (previous_hour != h)
+    {
+      h  = previous_hour;
+      mi = s = 59;
+    }
+
+    auto previous_minute = data.get_minutes().prev(mi);
+    if (previous_minute < 0)
+    {
+      --h;
+      mi = s = 59;
+      continue;
+    }
+
+    if (previous_minute != mi)
+    {
+      mi = previous_minute;
+      s  = 59;
+    }
+
+    auto previous_second = data.get_seconds().prev(s);
+    if (previous_second < 0)
+    {
+      --mi;
+      s = 59;
+      continue;
+    }
+
+    s    = previous_second;
+    done = true;
+  }
+
+  return done;
+}
+
+uint64_t CronSchedule::count_between(
+  std::chrono::system_clock::time_point from,
+  std::chrono::system_clock::time_point until) const
+{
+  // Occurrences are whole seconds; count those in [ceil(from), ceil(until))
+  const auto first = date::ceil<seconds>(from);
+  const auto last  = date::ceil<seconds>(until);
+  if (last <= first) { return 0; }
+
+  const CalendarCursor f{first};
+  const CalendarCursor u{last};
+  const auto           first_day = date::floor<days>(first);
+  const auto           last_day  = date::floor<days>(last);
+
+  auto day_matches = [this](const CalendarCursor& x)
+  { return count_days(x, x.day, x.day) != 0; };
+
+  if (first_day == last_day)
+  {
+    return day_matches(f) ? count_in_day_from(f) - count_in_day_from(u) : 0;
+  }
+
+  const auto per_day = count_in_day_from(CalendarCursor{});
+
+  uint64_t res = day_matches(f) ? count_in_day_from(f) : 0;
+  if (day_matches(u)) { res += per_day - count_in_day_from(u); }
+
+  // Whole days in between, a month at a time
+  if (first_day + days{1} == last_day) { return res; }
+
+  CalendarCursor       c{first_day + days{1}};
+  const CalendarCursor end{last_day - days{1}};
+  for (;;)
+  {
+    const bool last_month = c.year == end.year && c.month == end.month;
+    res += per_day
+           * count_days(c, c.day, last_month ? end.day : c.days_in_month());
+    if (last_month) { break; }
+
+    c.day = 1;
+    if (++c.month > 12)
+    {
+      c.month = 1;
+      ++c.year;
+    }
+  }
+
+  return res;
+}
+
+uint64_t CronSchedule::count_in_day_from(const CalendarCursor& c) const
+{
+  const auto& h = data.get_hours();
+  const auto& m = data.get_minutes();
+  const auto& s = data.get_seconds();
+
+  // Occurrences in later hours, plus those in later minutes and at later
+  //  seconds of the current hour and minute
+  uint64_t res = h.count_from(c.hour + 1) * m.size() * s.size();
+
+  if (h.contains(static_cast<Hours>(c.hour)))
+  {
+    res += m.count_from(c.minute + 1) * s.size();
+
+    if (m.contains(static_cast<Minutes>(c.minute)))
+    {
+      res += s.count_from(c.second);
+    }
+  }
+
+  return res;
+}
+
+uint64_t CronSchedule::count_days(const CalendarCursor& c,
+                                  unsigned              first,
+                                  unsigned              last) const
+{
+  if (!data.get_months().contains(static_cast<Months>(c.month))) { return 0; }
+
+  // Same precedence as next_day()
+  const auto& dom = data.get_day_of_month();
+  if (dom.size() != CronData::value_of(DayOfMonth::Last))
+  {
+    return dom.count_from(static_cast<int>(first))
+           - dom.count_from(static_cast<int>(last) + 1);
+  }
+
+  // Each allowed weekday occurs once per whole week, plus once more if it
+  //  falls within the remaining days
+  const auto& dow   = data.get_day_of_week();
+  const auto  count = last - first + 1;
+  const auto  start = c.weekday_of(first);
+
+  uint64_t res = (count / 7) * dow.size();
+  for (unsigned offset = 0; offset < count % 7; ++offset)
+  {
+    if (dow.contains(static_cast<DayOfWeek>((start + offset) % 7))) { ++res; }
+  }
+
+  return res;
+}
+
+CronSchedule::OccurrenceIterator::OccurrenceIterator(
+  const CronSchedule&                   schedule,
+  std::chrono::system_clock::time_point from)
+  : schedule(&schedule), cursor(from)
+{
+  advance();
+}
+
+CronSchedule::OccurrenceIterator&
+CronSchedule::OccurrenceIterator::operator++()
+{
+  // Continue right after the current occurrence; the search carries into the
+  //  larger fields as needed.
+  ++cursor.second;
+  advance();
+  return *this;
+}
+
+void CronSchedule::OccurrenceIterator::advance()
+{
+  uint32_t iterations = 0;
+  if (!schedule->find_next(cursor, iterations))
+  {
+    schedule = nullptr;
+    return;
+  }
+
+  // The cursor only converts the date when the month changes
+  current = cursor.to_time_point();
+}
+
+int CronSchedule::next_day(const CalendarCursor& c) const
+{
+  const auto d        = c.day;
+  const auto last_day = c.days_in_month();
+  int        res      = -1;
+
+  if (d > last_day) { return res; }
+
+  // If all days are allowed (or the field is ignored via '?'), then the 'day
+  // of week' takes precedence.
+  if (data.get_day_of_month().size() != CronData::value_of(DayOfMonth::Last))
+  {
+    res = data.get_day_of_month().next(static_cast<int>(d));
+  }
+  else
+  {
+    auto weekday_of_d = c.weekday();
+
+    for (unsigned offset = 0; res < 0 && offset < 7; ++offset)
+    {
+      if (data.get_day_of_week().contains(
+            static_cast<DayOfWeek>((weekday_of_d + offset) % 7)))
       {
-        curr += minutes{1};
-        curr -= seconds{date_time.sec};
+        res = static_cast<int>(d + offset);
       }
-      else if (data.get_seconds().find(static_cast<Seconds>(date_time.sec)) ==
-               data.get_seconds().end())
+    }
+  }
+
+  return res > static_cast<int>(last_day) ? -1 : res;
+}
+
+int CronSchedule::previous_day(const CalendarCursor& c) const
+{
+  const auto d   = std::min(c.day, c.days_in_month());
+  int        res = -1;
+
+  if (d == 0) { return res; }
+
+  // Same precedence as next_day()
+  if (data.get_day_of_month().size() != CronData::value_of(DayOfMonth::Last))
+  {
+    res = data.get_day_of_month().prev(static_cast<int>(d));
+  }
+  else
+  {
+    auto weekday_of_d = c.weekday_of(d);
+
+    for (unsigned offset = 0; res < 0 && offset < 7; ++offset)
+    {
+      if (data.get_day_of_week().contains(
+            static_cast<DayOfWeek>((weekday_of_d + 7 - offset) % 7)))
       {
-        curr += seconds{1};
+        res = static_cast<int>(d) - static_cast<int>(offset);
       }
-      else { done = true; }
     }
   }
 
-  // Discard fraction seconds in the calculated schedule time
-  //  that may leftover from the argument `from`, which in turn comes from
-  //  `now()`.
-  // Fraction seconds will potentially make the task be triggered more than 1
-  // second late
-  //  if the `tick()` within the same second is earlier than schedule time,
-  //  in that the task will not trigger until the next `tick()` next second.
-  // By discarding fraction seconds in the scheduled time,
-  //  the `tick()` within the same second will never be earlier than schedule
-  //  time, and the task will trigger in that `tick()`.
-  curr -= curr.time_since_epoch() % seconds{1};
-
-  return std::make_tuple(max_iterations > 0, curr);
+  return res < 1 ? -1 : res;
 }
 }  // namespace libcron
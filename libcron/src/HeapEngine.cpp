@@ -0,0 +1,104 @@
+#include "libcron/HeapEngine.h"
+
+#include <utility>
+
+namespace libcron
+{
+void HeapEngine::insert(size_t slot, std::chrono::system_clock::time_point when)
+{
+  if (slot >= position.size())
+  {
+    position.resize(slot + 1);
+    due.resize(slot + 1);
+  }
+
+  due[slot]      = when;
+  position[slot] = heap.size();
+  heap.push_back(slot);
+  sift_up(heap.size() - 1);
+}
+
+void HeapEngine::erase(size_t slot)
+{
+  const auto pos  = position[slot];
+  const auto last = heap.size() - 1;
+
+  if (pos != last)
+  {
+    swap_positions(pos, last);
+    heap.pop_back();
+
+    // The slot moved into the hole may belong either above or below it.
+    sift_up(pos);
+    sift_down(position[heap[pos]]);
+  }
+  else { heap.pop_back(); }
+}
+
+void HeapEngine::update(size_t slot, std::chrono::system_clock::time_point when)
+{
+  const auto later = when > due[slot];
+  due[slot]        = when;
+
+  if (later) { sift_down(position[slot]); }
+  else { sift_up(position[slot]); }
+}
+
+size_t HeapEngine::next_due(std::chrono::system_clock::time_point now)
+{
+  return !heap.empty() && due[heap[0]] <= now ? heap[0] : npos;
+}
+
+size_t HeapEngine::earliest() const
+{
+  return heap.empty() ? npos : heap[0];
+}
+
+void HeapEngine::clear()
+{
+  heap.clear();
+  position.clear();
+  due.clear();
+}
+
+bool HeapEngine::earlier(size_t lhs_position, size_t rhs_position) const
+{
+  return due[heap[lhs_position]] < due[heap[rhs_position]];
+}
+
+void HeapEngine::swap_positions(size_t lhs_position, size_t rhs_position)
+{
+  std::swap(heap[lhs_position], heap[rhs_position]);
+  position[heap[lhs_position]] = lhs_position;
+  position[heap[rhs_position]] = rhs_position;
+}
+
+void HeapEngine::sift_up(size_t pos)
+{
+  while (pos > 0)
+  {
+    const auto parent = (pos - 1) / 2;
+    if (!earlier(pos, parent)) { break; }
+
+    swap_positions(pos, parent);
+    pos = parent;
+  }
+}
+
+void HeapEngine::sift_down(size_t pos)
+{
+  for (;;)
+  {
+    const auto left     = 2 * pos + 1;
+    const auto right    = left + 1;
+    auto       smallest = pos;
+
+    if (left < heap.size() && earlier(left, smallest)) { smallest = left; }
+    if (right < heap.size() && earlier(right, smallest)) { smallest = right; }
+    if (smallest == pos) { break; }
+
+    swap_positions(pos, smallest);
+    pos = smallest;
+  }
+}
+}  // namespace libcron
@@ -5,11 +5,123 @@ using namespace std::chrono;
 namespace libcron
 {
 
+bool TaskRunState::begin(OverlapPolicy policy)
+{
+  switch (policy)
+  {
+    case OverlapPolicy::Allow: return true;
+    case OverlapPolicy::Skip:
+    {
+      uint32_t idle = 0;
+      return runs.compare_exchange_strong(idle, 1, std::memory_order_acq_rel);
+    }
+    case OverlapPolicy::Coalesce:
+    {
+      // At most one run pending behind the one in progress
+      auto current = runs.load(std::memory_order_relaxed);
+      do
+      {
+        if (current >= 2) { return false; }
+      } while (!runs.compare_exchange_weak(current,
+                                           current + 1,
+                                           std::memory_order_acq_rel,
+                                           std::memory_order_relaxed));
+      return current == 0;
+    }
+    case OverlapPolicy::Serialize:
+      return runs.fetch_add(1, std::memory_order_acq_rel) == 0;
+  }
+
+  return true;
+}
+
+bool TaskRunState::end()
+{
+  return runs.fetch_sub(1, std::memory_order_acq_rel) > 1;
+}
+
+void TaskRunState::abandon()
+{
+  runs.store(0, std::memory_order_release);
+}
+
+void TaskRun::run() const
+{
+  do
+  {
+    try
+    {
+      (*task)(*this);
+    }
+    catch (...)
+    {
+      if (state) { state->abandon(); }
+      throw;
+    }
+  } while (state && state->end());
+}
+
+void Task::execute(std::chrono::system_clock::time_point now)
+{
+  if (auto run = dispatch(now)) { run->run(); }
+}
+
+std::optional<TaskRun> Task::dispatch(
+  std::chrono::system_clock::time_point now)
+{
+  // Next Schedule is still the current schedule, calculate delay (actual
+  // execution - planned execution)
+  delay = now - next_schedule;
+
+  last_run      = now;
+  last_executed = now;
+
+  // Runs are only tracked while the policy is not Allow
+  std::shared_ptr<TaskRunState> state;
+  if (overlap != OverlapPolicy::Allow)
+  {
+    if (!run_state->begin(overlap)) { return std::nullopt; }
+    state = run_state;
+  }
+
+  return TaskRun{name, task, std::move(state), delay, last_missed, key_hash};
+}
+
+void Task::set_execution_key(std::string key)
+{
+  execution_key = std::move(key);
+  if (execution_key.empty()) { key_hash.reset(); }
+  else { key_hash = std::hash<std::string>{}(execution_key); }
+}
+
+void Task::set_overlap_policy(OverlapPolicy policy)
+{
+  overlap = policy;
+  if (policy != OverlapPolicy::Allow && !run_state)
+  {
+    run_state = std::make_shared<TaskRunState>();
+  }
+}
+
 bool Task::calculate_next(std::chrono::system_clock::time_point from)
 {
-  auto result = schedule.calculate_from(from);
+  return set_next(next_from(*schedule, zone.get(), from));
+}
 
-  // In case the calculation fails, the task will no longer expire.
+std::tuple<bool, std::chrono::system_clock::time_point> Task::next_from(
+  const CronSchedule&                   schedule,
+  const TimeZone*                       zone,
+  std::chrono::system_clock::time_point from)
+{
+  return zone ? zone->calculate_from(schedule, from)
+              : schedule.calculate_from(from);
+}
+
+bool Task::set_next(
+  const std::tuple<bool, std::chrono::system_clock::time_point>& result)
+{
+  // In case the calculation fails, the task will no longer expire and is
+  // ordered after all valid tasks.
   valid = std::get<0>(result);
   if (valid)
   {
@@ -18,10 +130,25 @@ bool Task::calculate_next(std::chrono::system_clock::time_point from)
     // Make sure that the task is allowed to run.
     last_run = next_schedule - 1s;
   }
+  else { next_schedule = system_clock::time_point::max(); }
 
   return valid;
 }
 
+bool Task::reschedule(std::shared_ptr<const CronSchedule> new_schedule,
+                      std::chrono::system_clock::time_point now)
+{
+  schedule = std::move(new_schedule);
+
+  auto from = now;
+  if (last_executed <= now && last_executed > now - 1s)
+  {
+    from = last_executed + 1s;
+  }
+
+  return calculate_next(from);
+}
+
 bool Task::is_expired(std::chrono::system_clock::time_point now) const
 {
   return valid && now >= last_run && time_until_expiry(now) == 0s;
@@ -43,19 +170,19 @@ std::chrono::system_clock::duration Task::time_until_expiry(
 std::string Task::get_status(std::chrono::system_clock::time_point now) const
 {
   std::string s = "'";
-  s += get_name();
+  s += get_name_view();
   s += "' expires in ";
   s +=
     std::to_string(duration_cast<milliseconds>(time_until_expiry(now)).count());
   s += "ms => ";
 
-  auto dt = CronSchedule::to_calendar_time(next_schedule);
-  s += std::to_string(dt.year) + "-";
-  s += std::to_string(dt.month) + "-";
-  s += std::to_string(dt.day) + " ";
-  s += std::to_string(dt.hour) + ":";
-  s += std::to_string(dt.min) + ":";
-  s += std::to_string(dt.sec);
+  const CalendarCursor c{next_schedule};
+  s += std::to_string(c.year) + "-";
+  s += std::to_string(c.month) + "-";
+  s += std::to_string(c.day) + " ";
+  s += std::to_string(c.hour) + ":";
+  s += std::to_string(c.minute) + ":";
+  s += std::to_string(c.second);
   return s;
 }
 }  // namespace libcron
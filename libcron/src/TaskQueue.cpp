@@ -1,109 +1,369 @@
-#include "libcron/TaskQueue.h"
-
-#include <algorithm>
-#include <stdexcept>
-
-namespace libcron
-{
-TaskQueue::TaskQueue(std::shared_ptr<ICronLock> lock) : lockSptr(lock)
-{
-  if (!lockSptr) { throw std::invalid_argument("TaskQueue(): lock is null"); }
-}
-
-const std::vector<Task>& TaskQueue::get_tasks() const
-{
-  return c;
-}
-
-std::vector<Task>& TaskQueue::get_tasks()
-{
-  return c;
-}
-
-size_t TaskQueue::size() const noexcept
-{
-  return c.size();
-}
-
-bool TaskQueue::empty() const noexcept
-{
-  return c.empty();
-}
-
-void TaskQueue::push(Task& t)
-{
-  c.push_back(t);
-}
-
-void TaskQueue::push(Task&& t)
-{
-  c.push_back(std::move(t));
-}
-
-void TaskQueue::push(std::vector<Task>& tasks_to_insert)
-{
-  c.reserve(c.size() + tasks_to_insert.size());
-  c.insert(c.end(),
-           std::make_move_iterator(tasks_to_insert.begin()),
-           std::make_move_iterator(tasks_to_insert.end()));
-}
-
-const Task& TaskQueue::top() const
-{
-  return c[0];
-}
-
-Task& TaskQueue::at(const size_t i)
-{
-  return c[i];
-}
-
-void TaskQueue::sort()
-{
-  std::sort(c.begin(), c.end(), std::less<>());
-}
-
-void TaskQueue::clear()
-{
-  lockSptr->lock();
-  c.clear();
-  lockSptr->unlock();
-}
-
-void TaskQueue::remove(Task& to_remove)
-{
-  const std::string& nameToRemove(to_remove.get_name());
-  auto               it = std::find_if(c.begin(),
-                         c.end(),
-                         [&nameToRemove](const Task& to_compare)
-                         { return nameToRemove == to_compare; });
-
-  if (it != c.end()) { c.erase(it); }
-}
-
-void TaskQueue::remove(const std::string& to_remove)
-{
-  lockSptr->lock();
-
-  auto it = std::find_if(c.begin(),
-                         c.end(),
-                         [&to_remove](const Task& to_compare)
-                         { return to_remove == to_compare; });
-
-  if (it != c.end()) { c.erase(it); }
-
-  lockSptr->unlock();
-}
-
-void TaskQueue::lock_queue() const
-{
-  /* Do not allow to manipulate the Queue */
-  lockSptr->lock();
-}
-
-void TaskQueue::release_queue() const
-{
-  /* Allow Access to the Queue Manipulating-Functions */
-  lockSptr->unlock();
-}
-}  // namespace libcron
+#include "libcron/TaskQueue.h"
+
+#include <algorithm>
+#include <functional>
+#include <stdexcept>
+
+#include "libcron/HeapEngine.h"
+#include "libcron/TimingWheelEngine.h"
+
+namespace libcron
+{
+TaskQueue::TaskQueue(std::shared_ptr<ICronLock> lock, QueueEngineType engine)
+  : lockSptr(lock), engine_type(engine), engine(make_engine(engine))
+{
+  if (!lockSptr) { throw std::invalid_argument("TaskQueue(): lock is null"); }
+}
+
+TaskQueue::TaskQueue(TaskQueue&& other)
+  : TaskQueue(other.lockSptr, other.engine_type)
+{
+  *this = std::move(other);
+}
+
+TaskQueue& TaskQueue::operator=(TaskQueue&& other)
+{
+  if (this == &other) { return *this; }
+
+  lockSptr     = other.lockSptr;
+  engine_type  = other.engine_type;
+  engine       = std::move(other.engine);
+  slots        = std::move(other.slots);
+  free_slots   = std::move(other.free_slots);
+  generations  = std::move(other.generations);
+  group_of     = std::move(other.group_of);
+  member_index = std::move(other.member_index);
+  groups       = std::move(other.groups);
+  free_groups  = std::move(other.free_groups);
+  group_by_key = std::move(other.group_by_key);
+  by_name      = std::move(other.by_name);
+
+  other.engine = make_engine(other.engine_type);
+  other.slots.clear();
+  other.free_slots.clear();
+  other.generations.clear();
+  other.group_of.clear();
+  other.member_index.clear();
+  other.groups.clear();
+  other.free_groups.clear();
+  other.group_by_key.clear();
+  other.by_name.clear();
+
+  return *this;
+}
+
+std::unique_ptr<IQueueEngine> TaskQueue::make_engine(QueueEngineType type)
+{
+  switch (type)
+  {
+    case QueueEngineType::TimingWheel:
+      return std::make_unique<TimingWheelEngine>();
+    case QueueEngineType::BinaryHeap:
+    default:
+      return std::make_unique<HeapEngine>();
+  }
+}
+
+size_t TaskQueue::size() const noexcept
+{
+  return slots.size() - free_slots.size();
+}
+
+bool TaskQueue::empty() const noexcept
+{
+  return size() == 0;
+}
+
+TaskHandle TaskQueue::push(Task& t)
+{
+  return push(Task{t});
+}
+
+TaskHandle TaskQueue::push(Task&& t)
+{
+  const auto slot = allocate_slot(std::move(t));
+  join_group(slot);
+
+  return TaskHandle{static_cast<uint32_t>(slot), generations[slot]};
+}
+
+void TaskQueue::push(std::vector<Task>& tasks_to_insert)
+{
+  for (auto& t : tasks_to_insert) { push(std::move(t)); }
+}
+
+const Task* TaskQueue::find(TaskHandle handle) const
+{
+  return is_current(handle) ? slots[handle.index].get() : nullptr;
+}
+
+const Task& TaskQueue::top() const
+{
+  return *slots[groups[engine->earliest()].members.front()];
+}
+
+void TaskQueue::recalculate_all(std::chrono::system_clock::time_point from)
+{
+  // Groups merged into others along the way are left empty and skipped;
+  //  recalculating a group that absorbed others yields the same result again
+  for (size_t group = 0; group < groups.size(); ++group)
+  {
+    if (groups[group].members.empty()) { continue; }
+
+    const auto& key = groups[group].key;
+    if (key.when < from)
+    {
+      using namespace std::chrono_literals;
+      const auto missed =
+        key.zone ? key.zone->calculate_before(*key.schedule, from - 1s)
+                 : key.schedule->calculate_before(from - 1s);
+      if (std::get<0>(missed) && std::get<1>(missed) >= key.when)
+      {
+        for (auto slot : groups[group].members)
+        {
+          slots[slot]->set_missed(std::get<1>(missed));
+        }
+      }
+    }
+
+    const auto next = Task::next_from(*key.schedule, key.zone, from);
+    for (auto slot : groups[group].members) { slots[slot]->set_next(next); }
+
+    move_group(group,
+               slots[groups[group].members.front()]->get_next_schedule());
+  }
+}
+
+size_t TaskQueue::group_count() const noexcept
+{
+  return groups.size() - free_groups.size();
+}
+
+std::vector<const Task*> TaskQueue::sorted() const
+{
+  std::vector<const Task*> res;
+  res.reserve(size());
+
+  for_each([&res](const Task& t) { res.push_back(&t); });
+
+  std::sort(res.begin(),
+            res.end(),
+            [](const Task* lhs, const Task* rhs) { return *lhs < *rhs; });
+
+  return res;
+}
+
+void TaskQueue::clear()
+{
+  lockSptr->lock();
+
+  // Slots are kept so that their generations invalidate existing handles
+  free_slots.clear();
+  for (size_t slot = 0; slot < slots.size(); ++slot)
+  {
+    if (slots[slot])
+    {
+      slots[slot].reset();
+      ++generations[slot];
+    }
+    free_slots.push_back(slot);
+  }
+
+  by_name.clear();
+  groups.clear();
+  free_groups.clear();
+  group_by_key.clear();
+  engine->clear();
+  lockSptr->unlock();
+}
+
+void TaskQueue::remove(std::string_view to_remove)
+{
+  lockSptr->lock();
+
+  auto it = by_name.find(to_remove);
+  if (it != by_name.end()) { erase_slot(it->second); }
+
+  lockSptr->unlock();
+}
+
+bool TaskQueue::remove(TaskHandle to_remove)
+{
+  lockSptr->lock();
+
+  const auto found = is_current(to_remove);
+  if (found) { erase_slot(to_remove.index); }
+
+  lockSptr->unlock();
+
+  return found;
+}
+
+void TaskQueue::lock_queue() const
+{
+  /* Do not allow to manipulate the Queue */
+  lockSptr->lock();
+}
+
+void TaskQueue::release_queue() const
+{
+  /* Allow Access to the Queue Manipulating-Functions */
+  lockSptr->unlock();
+}
+
+size_t TaskQueue::allocate_slot(Task&& t)
+{
+  size_t slot;
+
+  if (free_slots.empty())
+  {
+    slot = slots.size();
+    slots.push_back(std::make_unique<Task>(std::move(t)));
+    generations.push_back(0);
+    group_of.push_back(IQueueEngine::npos);
+    member_index.push_back(0);
+  }
+  else
+  {
+    slot = free_slots.back();
+    free_slots.pop_back();
+    slots[slot] = std::make_unique<Task>(std::move(t));
+  }
+
+  by_name.emplace(slots[slot]->get_name_view(), slot);
+
+  return slot;
+}
+
+void TaskQueue::erase_slot(size_t slot)
+{
+  auto range = by_name.equal_range(slots[slot]->get_name_view());
+  for (auto it = range.first; it != range.second; ++it)
+  {
+    if (it->second == slot)
+    {
+      by_name.erase(it);
+      break;
+    }
+  }
+
+  leave_group(slot);
+  slots[slot].reset();
+  ++generations[slot];
+  free_slots.push_back(slot);
+}
+
+bool TaskQueue::is_current(TaskHandle handle) const
+{
+  return handle.index < slots.size() && slots[handle.index]
+         && generations[handle.index] == handle.generation;
+}
+
+size_t TaskQueue::GroupKeyHash::operator()(const GroupKey& key) const
+{
+  const auto ptr_hash  = std::hash<const CronSchedule*>{}(key.schedule)
+                        ^ std::hash<const TimeZone*>{}(key.zone);
+  const auto time_hash = std::hash<std::chrono::system_clock::rep>{}(
+    key.when.time_since_epoch().count());
+  return ptr_hash ^ (time_hash + 0x9e3779b9 + (ptr_hash << 6) + (ptr_hash >> 2));
+}
+
+TaskQueue::GroupKey TaskQueue::key_of(const Task& t)
+{
+  return GroupKey{
+    t.get_schedule().get(), t.get_time_zone().get(), t.get_next_schedule()};
+}
+
+void TaskQueue::join_group(size_t slot)
+{
+  const auto key = key_of(*slots[slot]);
+
+  size_t group;
+  auto   it = group_by_key.find(key);
+  if (it != group_by_key.end()) { group = it->second; }
+  else
+  {
+    if (free_groups.empty())
+    {
+      group = groups.size();
+      groups.emplace_back();
+    }
+    else
+    {
+      group = free_groups.back();
+      free_groups.pop_back();
+    }
+
+    groups[group].key = key;
+    group_by_key.emplace(key, group);
+    engine->insert(group, key.when);
+  }
+
+  auto& members      = groups[group].members;
+  group_of[slot]     = group;
+  member_index[slot] = members.size();
+  members.push_back(slot);
+}
+
+void TaskQueue::leave_group(size_t slot)
+{
+  const auto group   = group_of[slot];
+  auto&      members = groups[group].members;
+
+  // Swap with the last member so that leaving is O(1)
+  const auto last    = members.back();
+  members[member_index[slot]] = last;
+  member_index[last] = member_index[slot];
+  members.pop_back();
+  group_of[slot] = IQueueEngine::npos;
+
+  if (members.empty())
+  {
+    engine->erase(group);
+    free_group(group);
+  }
+}
+
+void TaskQueue::move_group(size_t                                group,
+                           std::chrono::system_clock::time_point when)
+{
+  auto& moved = groups[group];
+  if (moved.key.when == when) { return; }
+
+  group_by_key.erase(moved.key);
+  const GroupKey key{moved.key.schedule, moved.key.zone, when};
+
+  auto it = group_by_key.find(key);
+  if (it == group_by_key.end())
+  {
+    moved.key = key;
+    group_by_key.emplace(key, group);
+    engine->update(group, when);
+    return;
+  }
+
+  // Another group already waits for the same point in time; join it
+  auto& target = groups[it->second].members;
+  for (auto slot : moved.members)
+  {
+    group_of[slot]     = it->second;
+    member_index[slot] = target.size();
+    target.push_back(slot);
+  }
+
+  moved.members.clear();
+  engine->erase(group);
+  free_group(group);
+}
+
+void TaskQueue::free_group(size_t group)
+{
+  // The key may already have been dropped by move_group
+  auto it = group_by_key.find(groups[group].key);
+  if (it != group_by_key.end() && it->second == group)
+  {
+    group_by_key.erase(it);
+  }
+  free_groups.push_back(group);
+}
+}  // namespace libcron
@@ -0,0 +1,279 @@
+#include "libcron/TimeZone.h"
+
+#include <algorithm>
+#include <mutex>
+#include <unordered_map>
+
+#ifdef LIBCRON_HAS_TZ
+#  include <date/tz.h>
+#endif
+
+using namespace std::chrono;
+
+namespace libcron
+{
+namespace
+{
+// Transitions are assumed to be more than this far apart, so that a local
+//  time can only be affected by the offsets in effect this long before and
+//  after it.
+constexpr auto transition_spacing = hours{24};
+
+#ifdef LIBCRON_HAS_TZ
+std::vector<TimeZoneTransition> load_transitions(const date::time_zone& zone)
+{
+  using namespace date;
+
+  std::vector<TimeZoneTransition> res;
+
+  const sys_seconds last = sys_days{2100_y / 1 / 1};
+  for (sys_seconds time = sys_days{1970_y / 1 / 1}; time < last;)
+  {
+    const auto info = zone.get_info(time);
+    res.push_back(TimeZoneTransition{std::max(info.begin, time), info.offset});
+    time = info.end;
+  }
+
+  return res;
+}
+#endif
+
+struct ZoneTable
+{
+  std::mutex                                                       mutex;
+  std::unordered_map<std::string, std::shared_ptr<const TimeZone>> zones;
+};
+
+ZoneTable& zone_table()
+{
+  static ZoneTable table;
+  return table;
+}
+}  // namespace
+
+TimeZone::TimeZone(std::string name, std::vector<TimeZoneTransition> transitions)
+  : name(std::move(name)), transitions(std::move(transitions))
+{
+}
+
+std::shared_ptr<const TimeZone> TimeZone::locate(std::string_view name)
+{
+  auto&                       table = zone_table();
+  std::lock_guard<std::mutex> lock(table.mutex);
+
+  const std::string key{name};
+  auto              it = table.zones.find(key);
+  if (it != table.zones.end()) { return it->second; }
+
+  std::shared_ptr<const TimeZone> res;
+
+#ifdef LIBCRON_HAS_TZ
+  try
+  {
+    const auto* zone = date::locate_zone(key);
+    res = std::make_shared<const TimeZone>(key, load_transitions(*zone));
+    table.zones.emplace(key, res);
+  }
+  catch (const std::exception&)
+  {
+    // Unknown zone, or no time zone database
+  }
+#endif
+
+  return res;
+}
+
+std::chrono::seconds TimeZone::utc_offset(
+  std::chrono::system_clock::time_point time) const
+{
+  if (transitions.empty()) { return seconds{0}; }
+
+  return in_effect(time).offset;
+}
+
+const TimeZoneTransition& TimeZone::in_effect(
+  std::chrono::system_clock::time_point time) const
+{
+  auto it = std::upper_bound(transitions.begin(),
+                             transitions.end(),
+                             time,
+                             [](const auto& t, const TimeZoneTransition& tr)
+                             { return t < tr.begin; });
+
+  return it == transitions.begin() ? *it : *std::prev(it);
+}
+
+size_t TimeZone::candidates(std::chrono::system_clock::time_point  local,
+                            std::chrono::system_clock::time_point (&utc)[2],
+                            std::chrono::system_clock::time_point& gap_end) const
+{
+  const auto earlier = utc_offset(local - transition_spacing);
+  const auto later   = utc_offset(local + transition_spacing);
+
+  size_t res = 0;
+
+  if (utc_offset(local - earlier) == earlier) { utc[res++] = local - earlier; }
+  if (later != earlier && utc_offset(local - later) == later)
+  {
+    utc[res++] = local - later;
+  }
+
+  if (res == 2 && utc[1] < utc[0]) { std::swap(utc[0], utc[1]); }
+
+  if (res == 0)
+  {
+    // Clocks were set forward past the local time; the gap ends with the
+    //  transition that took effect in the meantime
+    gap_end = in_effect(local - earlier).begin;
+  }
+
+  return res;
+}
+
+std::tuple<bool, std::chrono::system_clock::time_point> TimeZone::to_utc(
+  std::chrono::system_clock::time_point local,
+  std::chrono::system_clock::time_point not_before) const
+{
+  system_clock::time_point utc[2];
+  system_clock::time_point gap_end;
+
+  const auto count = candidates(local, utc, gap_end);
+  if (count == 0) { return std::make_tuple(gap_end >= not_before, gap_end); }
+
+  for (size_t i = 0; i < count; ++i)
+  {
+    if (utc[i] >= not_before) { return std::make_tuple(true, utc[i]); }
+  }
+
+  return std::make_tuple(false, not_before);
+}
+
+std::tuple<bool, std::chrono::system_clock::time_point>
+TimeZone::calculate_from(
+  const CronSchedule&                          schedule,
+  const std::chrono::system_clock::time_point& from) const
+{
+  const system_clock::time_point not_before = floor<seconds>(from);
+  auto                           local      = to_local(not_before);
+
+  // During the second pass through an overlap, the repeated local times
+  //  already came around in the first one; the search continues where they
+  //  end, at the transition in the earlier offset
+  system_clock::time_point utc[2];
+  system_clock::time_point gap_end;
+  if (candidates(local, utc, gap_end) == 2 && utc[1] == not_before)
+  {
+    local = in_effect(not_before).begin + (local - utc[0]);
+  }
+  else if (in_effect(not_before).begin == not_before)
+  {
+    // Occurrences in a gap run at its transition, so they are still due there
+    const auto earlier = utc_offset(not_before - seconds{1});
+    if (not_before + earlier < local) { local = not_before + earlier; }
+  }
+
+  // A local time may only map to a point before not_before when it is
+  //  repeated; the next one will do then
+  for (int attempt = 0; attempt < 3; ++attempt)
+  {
+    const auto next = schedule.calculate_from(local);
+    if (!std::get<0>(next)) { break; }
+
+    const auto res = to_utc(std::get<1>(next), not_before);
+    if (std::get<0>(res)) { return res; }
+
+    local = std::get<1>(next) + seconds{1};
+  }
+
+  return std::make_tuple(false, from);
+}
+
+std::tuple<bool, std::chrono::system_clock::time_point>
+TimeZone::calculate_before(
+  const CronSchedule&                          schedule,
+  const std::chrono::system_clock::time_point& from) const
+{
+  const system_clock::time_point not_after = floor<seconds>(from);
+  auto                           local     = to_local(not_after);
+
+  for (int attempt = 0; attempt < 3; ++attempt)
+  {
+    const auto previous = schedule.calculate_before(local);
+    if (!std::get<0>(previous)) { break; }
+
+    // Repeated local times ran during their first pass only
+    system_clock::time_point utc[2];
+    system_clock::time_point gap_end;
+
+    const auto count = candidates(std::get<1>(previous), utc, gap_end);
+    const auto time  = count == 0 ? gap_end : utc[0];
+    if (time <= not_after) { return std::make_tuple(true, time); }
+
+    local = std::get<1>(previous) - seconds{1};
+  }
+
+  return std::make_tuple(false, from);
+}
+
+uint64_t TimeZone::count_between(
+  const CronSchedule&                   schedule,
+  std::chrono::system_clock::time_point from,
+  std::chrono::system_clock::time_point until) const
+{
+  if (transitions.empty() || until <= from)
+  {
+    return schedule.count_between(from, until);
+  }
+
+  // The civil time up to which occurrences have already come around; during
+  //  the second pass through an overlap, that is the end of the repeated
+  //  civil time, see calculate_from()
+  auto passed = system_clock::time_point::min();
+
+  // A transition right at from still gets its gap handled, the occurrences
+  //  in it run at from
+  auto next = std::lower_bound(transitions.begin(),
+                               transitions.end(),
+                               from,
+                               [](const TimeZoneTransition& tr, const auto& t)
+                               { return tr.begin < t; });
+  if (next != transitions.begin() && std::prev(next) != transitions.begin())
+  {
+    const auto current = std::prev(next);
+    passed             = current->begin + std::prev(current)->offset;
+  }
+
+  uint64_t res    = 0;
+  auto     start  = from;
+  auto     offset = next == transitions.begin() ? next->offset : std::prev(next)->offset;
+
+  for (;;)
+  {
+    const auto end =
+      next == transitions.end() || next->begin >= until ? until : next->begin;
+
+    const auto local_from = std::max(start + offset, passed);
+    res += schedule.count_between(local_from, end + offset);
+
+    if (end == until) { break; }
+
+    passed = end + offset;
+    if (next->offset > offset)
+    {
+      // Occurrences in the gap, and one at its end, run once at the transition
+      const auto gap_end = end + next->offset + seconds{1};
+      if (schedule.count_between(passed, gap_end) != 0)
+      {
+        ++res;
+        passed = gap_end;
+      }
+    }
+
+    start  = end;
+    offset = next->offset;
+    ++next;
+  }
+
+  return res;
+}
+}  // namespace libcron
@@ -0,0 +1,352 @@
+#include "libcron/TimingWheelEngine.h"
+
+#include "libcron/CronField.h"
+
+namespace libcron
+{
+namespace
+{
+constexpr int64_t seconds_per_minute = 60;
+constexpr int64_t seconds_per_hour   = 60 * seconds_per_minute;
+constexpr int64_t seconds_per_day    = 24 * seconds_per_hour;
+
+// Cursor jumps longer than this reposition all slots instead of walking the
+//  wheel minute by minute
+constexpr int64_t max_walk = seconds_per_day;
+
+int64_t floor_div(int64_t value, int64_t divisor)
+{
+  const auto q = value / divisor;
+  return (value % divisor < 0) ? q - 1 : q;
+}
+
+size_t floor_mod(int64_t value, int64_t divisor)
+{
+  return static_cast<size_t>(value - floor_div(value, divisor) * divisor);
+}
+}  // namespace
+
+TimingWheelEngine::TimingWheelEngine()
+{
+  heads.fill(npos);
+}
+
+void TimingWheelEngine::insert(size_t slot,
+                               std::chrono::system_clock::time_point when)
+{
+  if (slot >= due.size())
+  {
+    due.resize(slot + 1);
+    due_second.resize(slot + 1);
+    prev.resize(slot + 1, npos);
+    next.resize(slot + 1, npos);
+    bucket_of.resize(slot + 1, npos);
+  }
+
+  due[slot]        = when;
+  due_second[slot] = to_seconds(when);
+
+  if (!initialized)
+  {
+    current     = due_second[slot];
+    initialized = true;
+  }
+
+  link(slot);
+}
+
+void TimingWheelEngine::erase(size_t slot)
+{
+  unlink(slot);
+}
+
+void TimingWheelEngine::update(size_t slot,
+                               std::chrono::system_clock::time_point when)
+{
+  unlink(slot);
+  due[slot]        = when;
+  due_second[slot] = to_seconds(when);
+  link(slot);
+}
+
+size_t TimingWheelEngine::next_due(std::chrono::system_clock::time_point now)
+{
+  if (!initialized) { return npos; }
+
+  advance(to_seconds(now));
+
+  // Everything in the ready list is due within the current second; only a
+  //  sub-second due time can still be ahead of now.
+  for (auto slot = heads[ready_bucket]; slot != npos; slot = next[slot])
+  {
+    if (due[slot] <= now) { return slot; }
+  }
+
+  return npos;
+}
+
+size_t TimingWheelEngine::earliest() const
+{
+  if (heads[ready_bucket] != npos) { return earliest_in(ready_bucket); }
+
+  // Levels are ordered: every slot in a lower level is due before any slot
+  //  in a higher one, and buckets within a level are ordered from the cursor.
+  if (second_mask != 0)
+  {
+    return earliest_in(seconds_level
+                       + static_cast<size_t>(detail::countr_zero(second_mask)));
+  }
+
+  if (minute_mask != 0)
+  {
+    return earliest_in(minutes_level
+                       + static_cast<size_t>(detail::countr_zero(minute_mask)));
+  }
+
+  if (hour_mask != 0)
+  {
+    return earliest_in(hours_level
+                       + static_cast<size_t>(detail::countr_zero(hour_mask)));
+  }
+
+  if (in_wheel != 0)
+  {
+    const auto today = floor_div(current, seconds_per_day);
+    for (int64_t day = today + 1; day < today + days_ahead; ++day)
+    {
+      const auto bucket = days_level + floor_mod(day, days_ahead);
+      if (heads[bucket] != npos) { return earliest_in(bucket); }
+    }
+  }
+
+  return earliest_in(overflow_bucket);
+}
+
+void TimingWheelEngine::clear()
+{
+  heads.fill(npos);
+  second_mask = 0;
+  minute_mask = 0;
+  hour_mask   = 0;
+  in_wheel    = 0;
+  due.clear();
+  due_second.clear();
+  prev.clear();
+  next.clear();
+  bucket_of.clear();
+}
+
+int64_t TimingWheelEngine::to_seconds(std::chrono::system_clock::time_point when)
+{
+  return std::chrono::floor<std::chrono::seconds>(when)
+    .time_since_epoch()
+    .count();
+}
+
+size_t TimingWheelEngine::bucket_for(int64_t second) const
+{
+  if (second <= current) { return ready_bucket; }
+
+  if (floor_div(second, seconds_per_minute)
+      == floor_div(current, seconds_per_minute))
+  {
+    return seconds_level + floor_mod(second, seconds_per_minute);
+  }
+
+  if (floor_div(second, seconds_per_hour) == floor_div(current, seconds_per_hour))
+  {
+    return minutes_level
+           + floor_mod(floor_div(second, seconds_per_minute), 60);
+  }
+
+  const auto day = floor_div(second, seconds_per_day);
+  const auto today = floor_div(current, seconds_per_day);
+
+  if (day == today)
+  {
+    return hours_level + floor_mod(floor_div(second, seconds_per_hour), 24);
+  }
+
+  if (day - today < days_ahead)
+  {
+    return days_level + floor_mod(day, days_ahead);
+  }
+
+  return overflow_bucket;
+}
+
+void TimingWheelEngine::link(size_t slot)
+{
+  const auto bucket = bucket_for(due_second[slot]);
+
+  prev[slot]      = npos;
+  next[slot]      = heads[bucket];
+  bucket_of[slot] = bucket;
+
+  if (heads[bucket] != npos) { prev[heads[bucket]] = slot; }
+  heads[bucket] = slot;
+
+  if (bucket < ready_bucket) { ++in_wheel; }
+
+  if (bucket < minutes_level)
+  {
+    second_mask |= uint64_t{1} << (bucket - seconds_level);
+  }
+  else if (bucket < hours_level)
+  {
+    minute_mask |= uint64_t{1} << (bucket - minutes_level);
+  }
+  else if (bucket < days_level)
+  {
+    hour_mask |= uint64_t{1} << (bucket - hours_level);
+  }
+}
+
+void TimingWheelEngine::unlink(size_t slot)
+{
+  const auto bucket = bucket_of[slot];
+
+  if (prev[slot] != npos) { next[prev[slot]] = next[slot]; }
+  else { heads[bucket] = next[slot]; }
+
+  if (next[slot] != npos) { prev[next[slot]] = prev[slot]; }
+
+  prev[slot]      = npos;
+  next[slot]      = npos;
+  bucket_of[slot] = npos;
+
+  if (bucket < ready_bucket) { --in_wheel; }
+
+  if (heads[bucket] == npos)
+  {
+    if (bucket < minutes_level)
+    {
+      second_mask &= ~(uint64_t{1} << (bucket - seconds_level));
+    }
+    else if (bucket < hours_level)
+    {
+      minute_mask &= ~(uint64_t{1} << (bucket - minutes_level));
+    }
+    else if (bucket < days_level)
+    {
+      hour_mask &= ~(uint64_t{1} << (bucket - hours_level));
+    }
+  }
+}
+
+void TimingWheelEngine::redistribute(size_t bucket)
+{
+  auto slot = heads[bucket];
+
+  while (slot != npos)
+  {
+    const auto following = next[slot];
+    unlink(slot);
+    link(slot);
+    slot = following;
+  }
+}
+
+void TimingWheelEngine::enter(int64_t second)
+{
+  if (floor_mod(second, seconds_per_minute) == 0)
+  {
+    if (floor_mod(second, seconds_per_day) == 0)
+    {
+      redistribute(days_level
+                   + floor_mod(floor_div(second, seconds_per_day), days_ahead));
+      redistribute(overflow_bucket);
+    }
+
+    if (floor_mod(second, seconds_per_hour) == 0)
+    {
+      redistribute(hours_level
+                   + floor_mod(floor_div(second, seconds_per_hour), 24));
+    }
+
+    redistribute(minutes_level
+                 + floor_mod(floor_div(second, seconds_per_minute), 60));
+  }
+
+  redistribute(seconds_level + floor_mod(second, seconds_per_minute));
+}
+
+void TimingWheelEngine::advance(int64_t target)
+{
+  if (target == current) { return; }
+
+  if (target < current || target - current > max_walk)
+  {
+    reset_cursor(target);
+    return;
+  }
+
+  while (current < target)
+  {
+    if (in_wheel == 0 && heads[overflow_bucket] == npos)
+    {
+      current = target;
+      break;
+    }
+
+    // Jump straight to the next occupied second of this minute, or to the
+    //  start of the next minute, hour or day, skipping over empty levels.
+    const auto within = floor_mod(current, seconds_per_minute);
+    const auto later  = second_mask & (~uint64_t{0} << (within + 1));
+
+    auto period = seconds_per_day;
+    if (minute_mask != 0 || second_mask != 0) { period = seconds_per_minute; }
+    else if (hour_mask != 0) { period = seconds_per_hour; }
+
+    auto next_second = (floor_div(current, period) + 1) * period;
+    if (later != 0)
+    {
+      next_second = current - static_cast<int64_t>(within)
+                    + detail::countr_zero(later);
+    }
+
+    if (next_second > target)
+    {
+      current = target;
+      break;
+    }
+
+    current = next_second;
+    enter(current);
+  }
+}
+
+void TimingWheelEngine::reset_cursor(int64_t target)
+{
+  std::vector<size_t> all;
+
+  for (auto bucket = heads.begin(); bucket != heads.end(); ++bucket)
+  {
+    for (auto slot = *bucket; slot != npos; slot = next[slot])
+    {
+      all.push_back(slot);
+    }
+  }
+
+  heads.fill(npos);
+  second_mask = 0;
+  minute_mask = 0;
+  hour_mask   = 0;
+  in_wheel    = 0;
+  current     = target;
+
+  for (auto slot : all) { link(slot); }
+}
+
+size_t TimingWheelEngine::earliest_in(size_t bucket) const
+{
+  auto best = heads[bucket];
+
+  for (auto slot = best; slot != npos; slot = next[slot])
+  {
+    if (due[slot] < due[best]) { best = slot; }
+  }
+
+  return best;
+}
+}  // namespace libcron
@@ -0,0 +1,123 @@
+#include <date/date.h>
+#include <libcron/include/libcron/Cron.h>
+#include <catch.hpp>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace libcron;
+using namespace date;
+using namespace std::chrono;
+
+// Benchmarks are hidden from the default test run; run them explicitly with
+// `cron_test "[benchmark]"`.
+
+SCENARIO("Calculating next occurrence", "[.][benchmark]")
+{
+  const auto from = sys_days{2018_y / 3 / 1} + hours{12};
+
+  for (const auto& expression :
+       {"* * * * * ?", "0 0 12 * * MON-FRI", "0 0 0 29 2 ?", "0 0 0 31 * ?"})
+  {
+    auto c{CronData::create(expression)};
+    REQUIRE(c.has_value());
+    CronSchedule sched(*c);
+
+    uint32_t iterations = 0;
+    REQUIRE(std::get<0>(sched.calculate_from(from, iterations)));
+    INFO(expression << " takes " << iterations << " iterations");
+    CHECK(iterations < 40);
+
+    BENCHMARK(expression)
+    {
+      return sched.calculate_from(from);
+    };
+  }
+}
+
+SCENARIO("Enumerating many occurrences", "[.][benchmark]")
+{
+  const auto from = sys_days{2018_y / 3 / 1} + hours{12};
+
+  for (const auto& expression : {"* * * * * ?", "0 */5 9-17 ? * MON-FRI"})
+  {
+    auto c{CronData::create(expression)};
+    REQUIRE(c.has_value());
+    CronSchedule sched(*c);
+
+    BENCHMARK(std::string{expression} + ", 10k calculate_from")
+    {
+      system_clock::time_point time = from;
+      for (int i = 0; i < 10000; ++i)
+      {
+        time = std::get<1>(sched.calculate_from(time)) + seconds{1};
+      }
+      return time;
+    };
+
+    BENCHMARK(std::string{expression} + ", 10k from an iterator")
+    {
+      auto it = sched.occurrences(from).begin();
+      for (int i = 1; i < 10000; ++i) { ++it; }
+      return *it;
+    };
+  }
+}
+
+SCENARIO("Reading clocks", "[.][benchmark]")
+{
+  const std::vector<std::pair<const char*, std::shared_ptr<ICronClock>>> clocks{
+    {"UTCClock", std::make_shared<UTCClock>()},
+    {"CoarseUTCClock", std::make_shared<CoarseUTCClock>()},
+    {"LocalClock", std::make_shared<LocalClock>()},
+    {"CoarseLocalClock", std::make_shared<CoarseLocalClock>()}};
+
+  for (const auto& [name, clock] : clocks)
+  {
+    BENCHMARK(std::string{name} + "::now()")
+    {
+      return clock->now();
+    };
+
+    // A tick with nothing due is dominated by reading the clock
+    Cron c{std::make_shared<NullLock>(), clock};
+    REQUIRE(c.add_schedule("Task", "0 0 0 1 1 ?", [](auto&) {}));
+    c.tick();
+
+    BENCHMARK(std::string{name} + ", tick")
+    {
+      return c.tick();
+    };
+  }
+}
+
+SCENARIO("Running many short callbacks", "[.][benchmark]")
+{
+  constexpr int run_count = 10000;
+  const auto    work =
+    std::make_shared<const Task::TaskFunction>([](const TaskInformation&) {});
+
+  ThreadPoolExecutor   pool;
+  WorkStealingExecutor stealing;
+
+  auto hand_over = [&work](ICronExecutor& executor)
+  {
+    for (int i = 0; i < run_count; ++i)
+    {
+      executor.execute(TaskRun{std::make_shared<const std::string>("Run"), work, nullptr, seconds{0}, system_clock::time_point::min()});
+    }
+  };
+
+  BENCHMARK("ThreadPoolExecutor, 10k runs")
+  {
+    hand_over(pool);
+    pool.wait_idle();
+  };
+
+  BENCHMARK("WorkStealingExecutor, 10k runs")
+  {
+    hand_over(stealing);
+    stealing.wait_idle();
+  };
+}
@@ -4,19 +4,23 @@
 #include <date/date.h>
 #include <libcron/include/libcron/Cron.h>
 #include <libcron/include/libcron/CronData.h>
+#include <libcron/include/libcron/CronDataCache.h>
 #include <catch.hpp>
+#include <iostream>
+#include <random>
+#include <thread>
 
 using namespace libcron;
 using namespace date;
 using namespace std::chrono;
 
 template<typename T>
-bool has_value_range(const std::set<T>& set, uint8_t low, uint8_t high)
+bool has_value_range(const CronField<T>& set, uint8_t low, uint8_t high)
 {
   bool found = true;
   for (auto i = low; found && i <= high; ++i)
   {
-    found &= set.find(static_cast<T>(i)) != set.end();
+    found &= set.contains(static_cast<T>(i));
   }
 
   return found;
@@ -242,3 +246,293 @@ SCENARIO("Replacing text with numbers")
             "1-12");
   }
 }
+
+SCENARIO("Compact field representation")
+{
+  GIVEN("A compiled expression")
+  {
+    auto c = CronData::create("0,15,30-31 * 22-2 ? * MON-WED,SAT");
+    REQUIRE(c.has_value());
+
+    THEN("It is small and trivially copyable")
+    {
+      REQUIRE(std::is_trivially_copyable<CronData>::value);
+      REQUIRE(sizeof(CronData) <= 32);
+    }
+    AND_THEN("Fields iterate in value order")
+    {
+      std::vector<int> seconds;
+      for (auto s : c->get_seconds()) { seconds.push_back(CronData::value_of(s)); }
+      REQUIRE(seconds == std::vector<int>{0, 15, 30, 31});
+
+      std::vector<int> hours;
+      for (auto h : c->get_hours()) { hours.push_back(CronData::value_of(h)); }
+      REQUIRE(hours == std::vector<int>{0, 1, 2, 22, 23});
+    }
+    AND_THEN("Lookups behave like std::set")
+    {
+      REQUIRE(c->get_day_of_week().size() == 4);
+      REQUIRE(c->get_day_of_week().contains(DayOfWeek::Last));
+      REQUIRE(c->get_day_of_week().find(static_cast<DayOfWeek>(4)) ==
+              c->get_day_of_week().end());
+      REQUIRE(*c->get_day_of_week().find(static_cast<DayOfWeek>(2)) ==
+              static_cast<DayOfWeek>(2));
+      REQUIRE(c->get_day_of_month().size() == 31);
+    }
+  }
+}
+
+bool same_result(const std::string& expression)
+{
+  const auto fast      = CronData::create(expression);
+  const auto reference = CronData::create_using_regex(expression);
+
+  // The compile time parser, run at run time here, must agree as well
+  const auto fixed = CronData::create_constexpr(expression);
+
+  const bool same =
+    fast.has_value() == reference.has_value() &&
+    fast.has_value() == fixed.has_value() && (!fast || *fast == *fixed) &&
+    (!fast ||
+     (fast->get_seconds() == reference->get_seconds() &&
+      fast->get_minutes() == reference->get_minutes() &&
+      fast->get_hours() == reference->get_hours() &&
+      fast->get_day_of_month() == reference->get_day_of_month() &&
+      fast->get_months() == reference->get_months() &&
+      fast->get_day_of_week() == reference->get_day_of_week()));
+
+  if (!same) { std::cout << "Mismatch for '" << expression << "'\n"; }
+
+  return same;
+}
+
+SCENARIO("Hand-written parser matches the regex reference")
+{
+  GIVEN("Hand-picked expressions")
+  {
+    const std::vector<std::string> expressions{
+      "* * * * * ?",
+      " \t* * * * * ?\n",
+      "*  *   * * * ?",
+      "* * * * *",
+      "* * * * * ? *",
+      "* * * * * ? ",
+      "* * * * * *",
+      "* * * 1 * 2",
+      "0 0 12 * * MON-FRI",
+      "0 0 12 1/2 * ?",
+      "0 0 */12 ? * *",
+      "0,3,40-50 * * * * ?",
+      "0, 3, 40-50 * * * * ?",
+      "* * 20-5 * * ?",
+      "* * * ? APR-JAN *",
+      "* * * ? * sat-tue,wed",
+      "* * * * JAN/2 ?",
+      "* * * * jan-Mar,DEC ?",
+      "* * * * JANFEB ?",
+      "* * * ? * MONSUN",
+      "* * * ? * SUNMON",
+      "1, * * * * ?",
+      ",1 * * * * ?",
+      "1,,2 * * * * ?",
+      "1-2-3 * * * * ?",
+      "1/2/3 * * * * ?",
+      "*/0 * * * * ?",
+      "*-3 * * * * ?",
+      "?/3 * * * * ?",
+      "5/3 * * * * ?",
+      "59/60 * * * * ?",
+      "0 0 * 30 FEB *",
+      "0 0 * 31 APR *",
+      "0 0 * 31 APR,MAY ?",
+      "0 0 * 29 FEB ?",
+      "@hourly",
+      "@hourly ?",
+      "@daily ?",
+      "@weekly",
+      "@monthly ?",
+      "@yearly ?",
+      "@annually ?",
+      "x@dailyy ?",
+      "",
+      "-",
+      "* ",
+      "007 * * * * ?",
+      "* * * * 0-12 ?"};
+
+    THEN("Both parsers agree")
+    {
+      for (const auto& e : expressions) { REQUIRE(same_result(e)); }
+    }
+  }
+
+  GIVEN("Randomly generated expressions")
+  {
+    std::mt19937                    twister{4711};
+    const std::vector<std::string> atoms{
+      "*",   "?",   "0",   "1",    "7",    "12",   "23",   "29",  "31",
+      "59",  "60",  "99",  "1-5",  "5-1",  "0-59", "22-3", "*/5", "3/7",
+      "0/1", "*/0", "JAN", "feb",  "Dec",  "SUN",  "mon",  "Sat", "MAR-JAN",
+      "FRI-TUE",  "1-",  "-1",  "/2",  "a",  "1-2/3", "", "@daily", "@hourly"};
+
+    auto pick = [&twister](size_t count)
+    {
+      return std::uniform_int_distribution<size_t>(0, count - 1)(twister);
+    };
+
+    THEN("Both parsers agree")
+    {
+      for (int i = 0; i < 5000; ++i)
+      {
+        std::string expression;
+        const auto  field_count = 5 + pick(3);
+
+        for (size_t field = 0; field < field_count; ++field)
+        {
+          if (field > 0) { expression += pick(8) == 0 ? "  " : " "; }
+
+          const auto part_count = 1 + pick(3);
+          for (size_t part = 0; part < part_count; ++part)
+          {
+            if (part > 0) { expression += ","; }
+            expression += atoms[pick(atoms.size())];
+          }
+        }
+
+        REQUIRE(same_result(expression));
+      }
+    }
+  }
+}
+
+SCENARIO("Parse cache")
+{
+  GIVEN("A cache holding at most 32 expressions")
+  {
+    CronDataCache cache{32};
+    REQUIRE(cache.capacity() == 32);
+
+    WHEN("Prewarming it")
+    {
+      REQUIRE(cache.prewarm({"* * * * * ?", "0 0 12 * * ?", "invalid"}) == 2);
+
+      THEN("Valid expressions are found by string_view")
+      {
+        std::string_view key{"0 0 12 * * ?"};
+        auto             found = cache.find(key);
+        REQUIRE(found);
+        REQUIRE(found->get_hours().contains(static_cast<Hours>(12)));
+        REQUIRE_FALSE(cache.find("invalid"));
+        REQUIRE(cache.size() == 2);
+        REQUIRE(cache.stats().hits == 1);
+        REQUIRE(cache.stats().misses == 1);
+      }
+      AND_THEN("Clearing empties it but keeps the counters")
+      {
+        REQUIRE(cache.find("* * * * * ?"));
+        cache.clear();
+        REQUIRE(cache.size() == 0);
+        REQUIRE_FALSE(cache.find("* * * * * ?"));
+        REQUIRE(cache.stats().hits == 1);
+        REQUIRE(cache.stats().misses == 1);
+
+        cache.reset_stats();
+        REQUIRE(cache.stats().hits == 0);
+      }
+    }
+    AND_WHEN("Adding many more expressions than it can hold")
+    {
+      for (int i = 0; i < 1000; ++i)
+      {
+        const auto expression = std::to_string(i % 60) + " " + std::to_string(i / 60) + " * * * ?";
+        cache.insert(expression, *CronData::create_uncached(expression));
+      }
+
+      THEN("The least recently used ones are evicted")
+      {
+        REQUIRE(cache.size() <= 32);
+        REQUIRE(cache.stats().evictions == 1000 - cache.size());
+        REQUIRE(cache.find("39 16 * * * ?"));
+        REQUIRE_FALSE(cache.find("0 0 * * * ?"));
+      }
+      AND_THEN("Shrinking it evicts more")
+      {
+        cache.set_capacity(16);
+        REQUIRE(cache.size() <= 16);
+      }
+    }
+  }
+  AND_GIVEN("Several threads parsing the same expressions")
+  {
+    std::vector<std::thread> threads;
+    std::atomic<int>         failures{0};
+
+    for (int t = 0; t < 8; ++t)
+    {
+      threads.emplace_back([&failures, t]()
+                           {
+                             for (int i = 0; i < 2000; ++i)
+                             {
+                               const auto expression = std::to_string((i + t) % 60) + " * * * * ?";
+                               auto       c          = CronData::create(expression);
+                               if (!c || !c->get_seconds().contains(static_cast<Seconds>((i + t) % 60)))
+                               {
+                                 ++failures;
+                               }
+                             }
+                           });
+    }
+
+    for (auto& thread : threads) { thread.join(); }
+
+    THEN("All of them see correct results")
+    {
+      REQUIRE(failures == 0);
+      REQUIRE(CronData::cache().find("59 * * * * ?"));
+    }
+  }
+}
+
+SCENARIO("Compile time parsing")
+{
+  using namespace libcron::literals;
+
+  GIVEN("Expressions parsed in constant expressions")
+  {
+    constexpr auto every_five_minutes = LIBCRON_CRON_EXPR("0 */5 * * * ?");
+    constexpr auto weekdays           = "0 0 12 ? * MON-FRI"_cron;
+    constexpr auto hourly             = CronData::create_constexpr("@hourly ?");
+
+    static_assert(every_five_minutes.get_minutes().size() == 12, "");
+    static_assert(every_five_minutes.get_minutes().contains(static_cast<Minutes>(55)), "");
+    static_assert(weekdays.get_day_of_week().size() == 5, "");
+    static_assert(!weekdays.get_day_of_week().contains(DayOfWeek::First), "");
+    static_assert(hourly && hourly->get_seconds().size() == 1 && hourly->get_minutes().size() == 60, "");
+    static_assert(!CronData::create_constexpr("0 0 * 30 FEB ?"), "");
+    static_assert(!CronData::create_constexpr("60 * * * * ?"), "");
+
+    THEN("They equal their run time counterparts")
+    {
+      REQUIRE(every_five_minutes == *CronData::create("0 */5 * * * ?"));
+      REQUIRE(weekdays == *CronData::create("0 0 12 ? * MON-FRI"));
+      REQUIRE(*hourly == *CronData::create("@hourly ?"));
+    }
+    AND_THEN("They can be scheduled without parsing")
+    {
+      Cron c;
+      int  runs = 0;
+      c.add_schedule("Every second", LIBCRON_CRON_EXPR("* * * * * ?"), [&runs](auto&) { ++runs; });
+      REQUIRE(c.count() == 1);
+      REQUIRE(c.tick() == 1);
+      REQUIRE(runs == 1);
+    }
+  }
+  AND_GIVEN("An invalid expression evaluated at run time")
+  {
+    THEN("The literal throws")
+    {
+      std::string_view expression{"* * * * * * * ?"};
+      REQUIRE_THROWS_AS(operator""_cron(expression.data(), expression.size()), std::invalid_argument);
+    }
+  }
+}
@@ -3,6 +3,8 @@
 #include <catch.hpp>
 #include <chrono>
 #include <iostream>
+#include <random>
+#include <sstream>
 
 using namespace libcron;
 using namespace date;
@@ -230,3 +232,462 @@ SCENARIO("Unable to calculate time point")
 {
   REQUIRE_FALSE(test("0 0 * 31 FEB *", DT(2021_y / 1 / 1), DT(2022_y / 1 / 1)));
 }
+
+// The previous, walking implementation of CronSchedule::calculate_from(), kept
+// as a reference for the field-wise search.
+std::tuple<bool, system_clock::time_point> walk_from(const CronData& data,
+                                                     system_clock::time_point from)
+{
+  auto curr           = from;
+  bool done           = false;
+  auto max_iterations = std::numeric_limits<uint16_t>::max();
+
+  while (!done && --max_iterations > 0)
+  {
+    bool           date_changed = false;
+    year_month_day ymd          = date::floor<days>(curr);
+
+    if (!data.get_months().contains(static_cast<Months>(unsigned(ymd.month()))))
+    {
+      auto     next_month = ymd + months{1};
+      sys_days s          = next_month.year() / next_month.month() / 1;
+      curr                = s;
+      date_changed        = true;
+    }
+    else if (data.get_day_of_month().size() !=
+             CronData::value_of(DayOfMonth::Last))
+    {
+      if (!data.get_day_of_month().contains(
+            static_cast<DayOfMonth>(unsigned(ymd.day()))))
+      {
+        sys_days s = ymd;
+        curr       = s + days{1};
+        date_changed = true;
+      }
+    }
+    else
+    {
+      year_month_weekday ymw = date::floor<days>(curr);
+      if (!data.get_day_of_week().contains(
+            static_cast<DayOfWeek>(ymw.weekday().c_encoding())))
+      {
+        sys_days s = ymd;
+        curr       = s + days{1};
+        date_changed = true;
+      }
+    }
+
+    if (!date_changed)
+    {
+      auto date_time = CronSchedule::to_calendar_time(curr);
+      if (!data.get_hours().contains(static_cast<Hours>(date_time.hour)))
+      {
+        curr += hours{1};
+        curr -= minutes{date_time.min};
+        curr -= seconds{date_time.sec};
+      }
+      else if (!data.get_minutes().contains(static_cast<Minutes>(date_time.min)))
+      {
+        curr += minutes{1};
+        curr -= seconds{date_time.sec};
+      }
+      else if (!data.get_seconds().contains(static_cast<Seconds>(date_time.sec)))
+      {
+        curr += seconds{1};
+      }
+      else { done = true; }
+    }
+  }
+
+  curr -= curr.time_since_epoch() % seconds{1};
+
+  return std::make_tuple(max_iterations > 0, curr);
+}
+
+SCENARIO("Field-wise search")
+{
+  GIVEN("A sparse schedule")
+  {
+    auto c{CronData::create("0 0 0 29 2 ?")};
+    REQUIRE(c.has_value());
+    CronSchedule sched(*c);
+
+    THEN("The next leap day is found in a few steps")
+    {
+      uint32_t    iterations = 0;
+      const auto& result     = sched.calculate_from(
+        DT(2096_y / 3 / 1, hours{12}, minutes{13}, seconds{14}), iterations);
+
+      REQUIRE(std::get<0>(result));
+      REQUIRE((std::get<1>(result) == DT(2104_y / 2 / 29)));
+      REQUIRE(iterations < 40);
+    }
+  }
+
+  GIVEN("Random schedules and start times")
+  {
+    std::mt19937 twister{1234};
+
+    auto pick = [&twister](int low, int high)
+    { return std::uniform_int_distribution<int>(low, high)(twister); };
+
+    const std::vector<std::string> seconds_fields{"*", "0", "*/15", "30-5"};
+    const std::vector<std::string> minutes_fields{"*", "0", "5/20", "59"};
+    const std::vector<std::string> hours_fields{"*", "0", "22-2", "*/6"};
+    const std::vector<std::string> days{
+      "* * ?", "? * MON-FRI", "31 * ?", "1,15 */2 ?", "29 FEB ?",
+      "? DEC-FEB SUN", "30 APR,JUN ?", "13 * ?"};
+
+    THEN("Results match the walking implementation")
+    {
+      for (int i = 0; i < 2000; ++i)
+      {
+        const auto expression =
+          seconds_fields[pick(0, 3)] + " " + minutes_fields[pick(0, 3)] + " " +
+          hours_fields[pick(0, 3)] + " " + days[pick(0, 7)];
+
+        auto c{CronData::create(expression)};
+        REQUIRE(c.has_value());
+        CronSchedule sched(*c);
+
+        const auto from = DT(year{pick(1999, 2030)} / pick(1, 12) / pick(1, 28),
+                             hours{pick(0, 23)},
+                             minutes{pick(0, 59)},
+                             seconds{pick(0, 59)}) +
+                          milliseconds{pick(0, 999)};
+
+        const auto expected = walk_from(*c, from);
+        const auto actual   = sched.calculate_from(from);
+
+        std::ostringstream description;
+        description << expression << " from " << from;
+        INFO(description.str());
+        REQUIRE(std::get<0>(actual) == std::get<0>(expected));
+        REQUIRE((std::get<1>(actual) == std::get<1>(expected)));
+      }
+    }
+  }
+}
+
+SCENARIO("Interned schedules")
+{
+  GIVEN("Equivalent expressions written differently")
+  {
+    auto first  = CronSchedule::intern(*CronData::create("0 0 * * * ?"));
+    auto second = CronSchedule::intern(*CronData::create("0 0 */1 * * ?"));
+    auto third  = CronSchedule::intern(*CronData::create("0 0 0-23 * * ?"));
+    auto other  = CronSchedule::intern(*CronData::create("0 30 * * * ?"));
+
+    THEN("They share one schedule")
+    {
+      REQUIRE(first == second);
+      REQUIRE(first == third);
+      REQUIRE(first != other);
+    }
+    AND_WHEN("The last reference goes away")
+    {
+      const auto alive = CronSchedule::interned_count();
+      other.reset();
+
+      THEN("The schedule is released")
+      {
+        REQUIRE(CronSchedule::interned_count() == alive - 1);
+      }
+    }
+  }
+
+  GIVEN("A Cron instance with many tasks on few schedules")
+  {
+    Cron c;
+    for (int i = 0; i < 1000; ++i)
+    {
+      REQUIRE(c.add_schedule("Task-" + std::to_string(i),
+                             std::to_string(i % 3) + " 0 12 * * ?",
+                             [](auto&) {}));
+    }
+
+    THEN("Tasks refer to shared schedules")
+    {
+      auto shared = CronSchedule::intern(*CronData::create("1 0 12 * * ?"));
+      REQUIRE(shared.use_count() > 300);
+    }
+  }
+}
+
+SCENARIO("Enumerating occurrences")
+{
+  GIVEN("Schedules of varying density")
+  {
+    const std::vector<std::string> expressions{"* * * * * ?",
+                                               "*/15 59 23 * * ?",
+                                               "0 0 12 ? * MON-FRI",
+                                               "0 0 0 31 * ?",
+                                               "0 0 0 29 2 ?"};
+
+    // system_clock may not reach far beyond 2200
+    const auto until = DT(2200_y / 1 / 1);
+
+    THEN("The range yields the same times as repeated calculations")
+    {
+      for (const auto& expression : expressions)
+      {
+        auto c{CronData::create(expression)};
+        REQUIRE(c.has_value());
+        CronSchedule sched(*c);
+
+        const auto from = DT(2019_y / 12 / 31, hours{23}, minutes{59}, seconds{58}) +
+                          milliseconds{500};
+        auto       expected = from;
+        int        count    = 0;
+
+        for (auto occurrence : sched.occurrences(from))
+        {
+          const auto next = sched.calculate_from(expected);
+          REQUIRE(std::get<0>(next));
+
+          std::ostringstream description;
+          description << expression << " occurrence " << count;
+          INFO(description.str());
+          REQUIRE((occurrence == std::get<1>(next)));
+
+          expected = occurrence + seconds{1};
+          if (++count == 2000 || occurrence > until) { break; }
+        }
+
+        REQUIRE(count > 40);
+      }
+    }
+  }
+
+  GIVEN("An iterator at an occurrence")
+  {
+    auto c{CronData::create("0 0 * * * ?")};
+    REQUIRE(c.has_value());
+    CronSchedule sched(*c);
+
+    auto range = sched.occurrences(DT(2020_y / 1 / 1, hours{1}));
+    auto it    = range.begin();
+
+    THEN("It starts at, and steps past, that occurrence")
+    {
+      REQUIRE((*it == DT(2020_y / 1 / 1, hours{1})));
+      REQUIRE((*it++ == DT(2020_y / 1 / 1, hours{1})));
+      REQUIRE((*it == DT(2020_y / 1 / 1, hours{2})));
+      REQUIRE(it != range.end());
+      REQUIRE(range.begin() == range.begin());
+      REQUIRE(range.end() == CronSchedule::OccurrenceIterator{});
+    }
+  }
+}
+
+SCENARIO("Previous occurrence")
+{
+  GIVEN("A sparse schedule")
+  {
+    auto c{CronData::create("0 0 0 29 2 ?")};
+    REQUIRE(c.has_value());
+    CronSchedule sched(*c);
+
+    THEN("The previous leap day is found in a few steps")
+    {
+      uint32_t    iterations = 0;
+      const auto& result     = sched.calculate_before(
+        DT(2104_y / 2 / 28, hours{12}, minutes{13}, seconds{14}), iterations);
+
+      REQUIRE(std::get<0>(result));
+      REQUIRE((std::get<1>(result) == DT(2096_y / 2 / 29)));
+      REQUIRE(iterations < 40);
+    }
+    AND_THEN("An occurrence within the current second is found")
+    {
+      const auto& result = sched.calculate_before(DT(2096_y / 2 / 29) + milliseconds{300});
+
+      REQUIRE(std::get<0>(result));
+      REQUIRE((std::get<1>(result) == DT(2096_y / 2 / 29)));
+    }
+  }
+
+  GIVEN("Random schedules and start times")
+  {
+    std::mt19937 twister{4321};
+
+    auto pick = [&twister](int low, int high)
+    { return std::uniform_int_distribution<int>(low, high)(twister); };
+
+    const std::vector<std::string> seconds_fields{"*", "0", "*/15", "30-5"};
+    const std::vector<std::string> minutes_fields{"*", "0", "5/20", "59"};
+    const std::vector<std::string> hours_fields{"*", "0", "22-2", "*/6"};
+    const std::vector<std::string> days{
+      "* * ?", "? * MON-FRI", "31 * ?", "1,15 */2 ?", "29 FEB ?",
+      "? DEC-FEB SUN", "30 APR,JUN ?", "13 * ?"};
+
+    THEN("The result is the last occurrence at or before the start time")
+    {
+      for (int i = 0; i < 2000; ++i)
+      {
+        const auto expression =
+          seconds_fields[pick(0, 3)] + " " + minutes_fields[pick(0, 3)] + " " +
+          hours_fields[pick(0, 3)] + " " + days[pick(0, 7)];
+
+        auto c{CronData::create(expression)};
+        REQUIRE(c.has_value());
+        CronSchedule sched(*c);
+
+        const auto from = DT(year{pick(1999, 2030)} / pick(1, 12) / pick(1, 28),
+                             hours{pick(0, 23)},
+                             minutes{pick(0, 59)},
+                             seconds{pick(0, 59)}) +
+                          milliseconds{pick(0, 999)};
+
+        std::ostringstream description;
+        description << expression << " from " << from;
+        INFO(description.str());
+
+        uint32_t   iterations = 0;
+        const auto previous   = sched.calculate_before(from, iterations);
+        REQUIRE(std::get<0>(previous));
+        REQUIRE(iterations < 40);
+
+        const auto at   = sched.calculate_from(std::get<1>(previous));
+        const auto next = sched.calculate_from(std::get<1>(previous) + seconds{1});
+        REQUIRE((std::get<1>(at) == std::get<1>(previous)));
+        REQUIRE((std::get<1>(previous) <= from));
+        REQUIRE((std::get<1>(next) > from));
+      }
+    }
+  }
+}
+
+SCENARIO("Counting occurrences")
+{
+  GIVEN("Schedules over long intervals")
+  {
+    auto count = [](const char* expression, system_clock::time_point from, system_clock::time_point until)
+    {
+      auto c{CronData::create(expression)};
+      REQUIRE(c.has_value());
+      return CronSchedule{*c}.count_between(from, until);
+    };
+
+    THEN("Counts follow from the number of allowed values")
+    {
+      REQUIRE(count("* * * * * ?", DT(2021_y / 3 / 1), DT(2021_y / 3 / 31)) == 30 * 86400);
+      REQUIRE(count("0 0 12 ? * MON-FRI", DT(2021_y / 3 / 1), DT(2021_y / 4 / 1)) == 23);
+      REQUIRE(count("0 0 0 29 2 ?", DT(2000_y / 1 / 1), DT(2100_y / 12 / 31)) == 25);
+      REQUIRE(count("0 0 0 31 * ?", DT(2021_y / 1 / 1), DT(2022_y / 1 / 1)) == 7);
+      REQUIRE(count("* * * * * ?", DT(2021_y / 3 / 1), DT(2021_y / 3 / 1)) == 0);
+      REQUIRE(count("* * * * * ?", DT(2021_y / 3 / 2), DT(2021_y / 3 / 1)) == 0);
+      REQUIRE(count("* * * * * ?", DT(2021_y / 3 / 1) + milliseconds{1}, DT(2021_y / 3 / 1, hours{0}, minutes{0}, seconds{2})) == 1);
+    }
+  }
+
+  GIVEN("Random schedules and intervals")
+  {
+    std::mt19937 twister{2468};
+
+    auto pick = [&twister](int low, int high)
+    { return std::uniform_int_distribution<int>(low, high)(twister); };
+
+    const std::vector<std::string> seconds_fields{"0", "*/15", "30-5"};
+    const std::vector<std::string> minutes_fields{"0", "5/20", "59"};
+    const std::vector<std::string> hours_fields{"*", "0", "22-2", "*/6"};
+    const std::vector<std::string> days{
+      "* * ?", "? * MON-FRI", "31 * ?", "1,15 */2 ?", "29 FEB ?",
+      "? DEC-FEB SUN", "30 APR,JUN ?", "13 * ?"};
+
+    THEN("Counts match enumerating the occurrences")
+    {
+      for (int i = 0; i < 300; ++i)
+      {
+        const auto expression =
+          seconds_fields[pick(0, 2)] + " " + minutes_fields[pick(0, 2)] + " " +
+          hours_fields[pick(0, 3)] + " " + days[pick(0, 7)];
+
+        auto c{CronData::create(expression)};
+        REQUIRE(c.has_value());
+        CronSchedule sched(*c);
+
+        const auto from = DT(year{pick(1999, 2030)} / pick(1, 12) / pick(1, 28),
+                             hours{pick(0, 23)},
+                             minutes{pick(0, 59)},
+                             seconds{pick(0, 59)}) +
+                          milliseconds{pick(0, 999)};
+        const auto until = from + seconds{pick(0, 4 * 86400)} + milliseconds{pick(0, 999)};
+
+        uint64_t expected = 0;
+        for (auto occurrence : sched.occurrences(from))
+        {
+          if (occurrence >= until) { break; }
+          ++expected;
+        }
+
+        std::ostringstream description;
+        description << expression << " from " << from << " until " << until;
+        INFO(description.str());
+        REQUIRE(sched.count_between(from, until) == expected);
+      }
+    }
+  }
+}
+
+SCENARIO("Calendar cursor")
+{
+  GIVEN("Points in time around the epoch and across centuries")
+  {
+    THEN("The cursor agrees with the date library")
+    {
+      for (auto time = DT(1899_y / 12 / 25); time < DT(2101_y / 1 / 7); time += hours{37} + seconds{61})
+      {
+        const CalendarCursor c{time};
+        const sys_days       daypoint = floor<days>(time);
+        const year_month_day ymd{daypoint};
+
+        std::ostringstream description;
+        description << time;
+        INFO(description.str());
+        REQUIRE(c.year == int(ymd.year()));
+        REQUIRE(c.month == unsigned(ymd.month()));
+        REQUIRE(c.day == unsigned(ymd.day()));
+        REQUIRE(c.weekday() == weekday{daypoint}.c_encoding());
+        REQUIRE((c.to_time_point() == time));
+      }
+    }
+  }
+
+  GIVEN("A cursor moved field by field")
+  {
+    CalendarCursor c{DT(2020_y / 2 / 10, hours{13}, minutes{14}, seconds{15}) + milliseconds{500}};
+
+    THEN("Fraction seconds are discarded")
+    {
+      REQUIRE((c.to_time_point() == DT(2020_y / 2 / 10, hours{13}, minutes{14}, seconds{15})));
+      REQUIRE(c.days_in_month() == 29);
+    }
+    AND_THEN("Days within the month follow arithmetically")
+    {
+      c.day = 29;
+      c.hour = 23;
+      REQUIRE(c.weekday() == 6);  // Saturday
+      REQUIRE(c.weekday_of(1) == 6);
+      REQUIRE((c.to_time_point() == DT(2020_y / 2 / 29, hours{23}, minutes{14}, seconds{15})));
+    }
+    AND_THEN("Changing the month or year converts the date again")
+    {
+      c.month = 3;
+      c.day = 1;
+      REQUIRE(c.weekday() == 0);  // Sunday
+      REQUIRE((c.to_time_point() == DT(2020_y / 3 / 1, hours{13}, minutes{14}, seconds{15})));
+
+      c.year = 1969;
+      c.month = 12;
+      c.day = 31;
+      REQUIRE(c.weekday() == 3);  // Wednesday
+      REQUIRE(c.days_in_month() == 31);
+      REQUIRE((c.to_time_point() == DT(1969_y / 12 / 31, hours{13}, minutes{14}, seconds{15})));
+
+      c.year = 2100;
+      c.month = 2;
+      REQUIRE(c.days_in_month() == 28);
+    }
+  }
+}
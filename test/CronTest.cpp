@@ -2,7 +2,19 @@
 #include <libcron/include/libcron/Cron.h>
 #include <libcron/externals/date/include/date/date.h>
 #include <thread>
+#include <atomic>
+#include <future>
 #include <iostream>
+#include <algorithm>
+#include <map>
+#include <cstdlib>
+#include <ctime>
+#include <stdexcept>
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/timerfd.h>
+#endif
 
 using namespace libcron;
 using namespace std::chrono;
@@ -317,6 +329,27 @@ SCENARIO("Clock changes")
                 REQUIRE(c.tick() == 1);
             }
         }
+        AND_WHEN("Clock is moved forward >= 3h to between occurrences")
+        {
+            system_clock::time_point missed{};
+            c.clear_schedules();
+            REQUIRE(c.add_schedule("Clock change task", "0 0 * * * ?", [&missed](auto& i)
+            {
+                missed = i.get_last_missed();
+            })
+            );
+
+            THEN("The most recent skipped occurrence is recorded")
+            {
+                REQUIRE(c.tick() == 1);
+                REQUIRE((missed == system_clock::time_point::min()));
+                clock.add(hours{5} + minutes{30}); // 05:30
+                REQUIRE(c.tick() == 0);
+                clock.add(minutes{30}); // 06:00
+                REQUIRE(c.tick() == 1);
+                REQUIRE((missed == sys_days{2018_y / 05 / 05} + hours{5}));
+            }
+        }
         AND_WHEN("Clock is moved back <3h")
         {
             THEN("Tasks retain their last scheduled time and are prevented from running twice")
@@ -450,3 +483,1150 @@ SCENARIO("Tasks can be added and removed from the scheduler")
         }
     }
 }
+
+SCENARIO("Tasks are executed in order of their schedule")
+{
+    GIVEN("A Cron instance with tasks expiring every few seconds")
+    {
+        std::shared_ptr<TestClock> testClock(std::make_shared<TestClock>());
+        Cron c{testClock};
+        auto& clock = *testClock;
+        clock.set(sys_days{2018_y / 05 / 05});
+
+        std::vector<int> executed;
+
+        // Task 'i' runs at second i * 3 of every minute, added in scrambled order
+        for (auto i : {7, 3, 11, 0, 19, 5, 1, 13, 17, 2, 9, 15})
+        {
+            REQUIRE(c.add_schedule("Task-" + std::to_string(i),
+                                   std::to_string(i * 3) + " * * * * ?",
+                                   [&executed, i](auto&)
+                                   {
+                                       executed.push_back(i);
+                                   }));
+        }
+
+        REQUIRE(c.count() == 12);
+
+        WHEN("Ticking through a minute")
+        {
+            for (int second = 0; second < 60; ++second)
+            {
+                c.tick();
+                clock.add(seconds{1});
+            }
+
+            THEN("All tasks ran once, in order")
+            {
+                REQUIRE(executed == std::vector<int>{0, 1, 2, 3, 5, 7, 9, 11, 13, 15, 17, 19});
+            }
+        }
+        AND_WHEN("Removing tasks")
+        {
+            c.remove_schedule("Task-0");
+            c.remove_schedule("Task-9");
+            c.remove_schedule("Task-19");
+            REQUIRE(c.count() == 9);
+
+            THEN("The next task is the earliest remaining one")
+            {
+                REQUIRE(c.time_until_next() == seconds{3});
+
+                for (int second = 0; second < 60; ++second)
+                {
+                    c.tick();
+                    clock.add(seconds{1});
+                }
+
+                REQUIRE(executed == std::vector<int>{1, 2, 3, 5, 7, 11, 13, 15, 17});
+            }
+        }
+        AND_WHEN("Listing the tasks")
+        {
+            std::vector<std::tuple<std::string, system_clock::duration>> status;
+            c.get_time_until_expiry_for_tasks(status);
+
+            THEN("They are ordered by expiry")
+            {
+                REQUIRE(status.size() == 12);
+                REQUIRE(std::is_sorted(status.begin(), status.end(),
+                                       [](const auto& l, const auto& r)
+                                       {
+                                           return std::get<1>(l) < std::get<1>(r);
+                                       }));
+                REQUIRE(std::get<0>(status.front()) == "Task-0");
+                REQUIRE(std::get<0>(status.back()) == "Task-19");
+            }
+        }
+    }
+}
+
+SCENARIO("Adding multiple schedules at once")
+{
+    GIVEN("A Cron instance and a map of schedules")
+    {
+        Cron c;
+        std::map<std::string, std::string> name_schedule_map;
+        for (int i = 1; i <= 100; i++)
+        {
+            name_schedule_map["Task-" + std::to_string(i)] = "* * * * * ?";
+        }
+
+        THEN("All valid schedules are added")
+        {
+            auto res = c.add_schedule(name_schedule_map, [](auto&) {});
+            REQUIRE(std::get<0>(res));
+            REQUIRE(c.count() == 100);
+            REQUIRE(c.tick() == 100);
+        }
+        AND_WHEN("One of them is invalid")
+        {
+            name_schedule_map["Task-100"] = "invalid";
+            auto res = c.add_schedule(name_schedule_map, [](auto&) {});
+
+            THEN("None is added")
+            {
+                REQUIRE_FALSE(std::get<0>(res));
+                REQUIRE(std::get<1>(res) == "Task-100");
+                REQUIRE(std::get<2>(res) == "invalid");
+                REQUIRE(c.count() == 0);
+            }
+        }
+    }
+}
+
+SCENARIO("Timing wheel engine")
+{
+    GIVEN("Two Cron instances, one per queue engine, with the same tasks")
+    {
+        auto heap_clock = std::make_shared<TestClock>();
+        auto wheel_clock = std::make_shared<TestClock>();
+        Cron heap{std::make_shared<NullLock>(), heap_clock, QueueEngineType::BinaryHeap};
+        Cron wheel{std::make_shared<NullLock>(), wheel_clock, QueueEngineType::TimingWheel};
+
+        const system_clock::time_point start = sys_days{2020_y / 02 / 28} + hours{22};
+        heap_clock->set(start);
+        wheel_clock->set(start);
+
+        std::vector<std::string> heap_log;
+        std::vector<std::string> wheel_log;
+
+        const std::vector<std::string> schedules{
+            "* * * * * ?", "*/7 * * * * ?", "0 * * * * ?", "30 */5 * * * ?", "0 0 * * * ?",
+            "15 45 23 * * ?", "0 0 0 * * ?", "0 0 12 29 2 ?", "0 0 1 ? * MON", "59 59 23 28-31 * ?"};
+
+        for (size_t i = 0; i < schedules.size(); ++i)
+        {
+            const auto name = "Task-" + std::to_string(i);
+            REQUIRE(heap.add_schedule(name, schedules[i], [&heap_log, heap_clock](auto& t)
+            {
+                heap_log.push_back(t.get_name() + "@" + std::to_string(heap_clock->now().time_since_epoch().count()));
+            }));
+            REQUIRE(wheel.add_schedule(name, schedules[i], [&wheel_log, wheel_clock](auto& t)
+            {
+                wheel_log.push_back(t.get_name() + "@" + std::to_string(wheel_clock->now().time_since_epoch().count()));
+            }));
+        }
+
+        WHEN("Ticking through two days with clock changes")
+        {
+            auto run = [&](system_clock::duration step)
+            {
+                heap_clock->add(step);
+                wheel_clock->add(step);
+                REQUIRE(heap.tick() == wheel.tick());
+                REQUIRE(heap.time_until_next() == wheel.time_until_next());
+            };
+
+            for (int i = 0; i < 2 * 86400; ++i)
+            {
+                run(seconds{1});
+
+                if (i == 3600) { run(-hours{1}); }
+                if (i == 7200) { run(minutes{90}); }
+                if (i == 50000) { run(hours{5}); }
+                if (i == 60000) { wheel.remove_schedule("Task-1"); heap.remove_schedule("Task-1"); }
+            }
+
+            THEN("Both ran the same tasks at the same times")
+            {
+                // Tasks due in the same second may run in a different order
+                std::sort(heap_log.begin(), heap_log.end());
+                std::sort(wheel_log.begin(), wheel_log.end());
+                REQUIRE(heap_log.size() > 150000);
+                REQUIRE(heap_log == wheel_log);
+            }
+        }
+    }
+}
+
+SCENARIO("Removing tasks by name")
+{
+    GIVEN("A Cron instance with many tasks")
+    {
+        Cron c;
+        for (int i = 0; i < 20000; ++i)
+        {
+            REQUIRE(c.add_schedule("Task-" + std::to_string(i), "0 0 12 * * ?", [](auto&) {}));
+        }
+
+        WHEN("Removing every other task")
+        {
+            for (int i = 0; i < 20000; i += 2)
+            {
+                const auto name = "Task-" + std::to_string(i);
+                c.remove_schedule(std::string_view{name});
+            }
+
+            THEN("Only the other half remains")
+            {
+                REQUIRE(c.count() == 10000);
+
+                std::vector<std::tuple<std::string, system_clock::duration>> status;
+                c.get_time_until_expiry_for_tasks(status);
+                REQUIRE(std::all_of(status.begin(), status.end(), [](const auto& s)
+                {
+                    return std::stoi(std::get<0>(s).substr(5)) % 2 == 1;
+                }));
+            }
+            AND_THEN("Names of removed tasks can be reused")
+            {
+                REQUIRE(c.add_schedule("Task-0", "* * * * * ?", [](auto&) {}));
+                REQUIRE(c.count() == 10001);
+                REQUIRE(c.tick() == 1);
+            }
+        }
+    }
+    AND_GIVEN("Two tasks sharing a name")
+    {
+        Cron c;
+        std::vector<std::string_view> names;
+        REQUIRE(c.add_schedule("Twin", "* * * * * ?", [&names](auto& t) { names.push_back(t.get_name_view()); }));
+        REQUIRE(c.add_schedule("Twin", "* * * * * ?", [&names](auto& t) { names.push_back(t.get_name_view()); }));
+
+        THEN("Each removal removes one of them")
+        {
+            REQUIRE(c.tick() == 2);
+            REQUIRE(names == std::vector<std::string_view>{"Twin", "Twin"});
+
+            c.remove_schedule("Twin");
+            REQUIRE(c.count() == 1);
+            c.remove_schedule("Twin");
+            REQUIRE(c.count() == 0);
+            c.remove_schedule("Twin");
+            REQUIRE(c.count() == 0);
+        }
+    }
+}
+
+SCENARIO("Task handles")
+{
+    GIVEN("A Cron instance with tasks added by handle")
+    {
+        auto testClock = std::make_shared<TestClock>();
+        Cron c{testClock};
+        testClock->set(sys_days{2018_y / 05 / 05});
+
+        TaskHandle first;
+        TaskHandle second;
+        TaskHandle duplicate;
+        REQUIRE(c.add_schedule("Task", "10 * * * * ?", [](auto&) {}, first));
+        REQUIRE(c.add_schedule("Task", "20 * * * * ?", [](auto&) {}, duplicate));
+        REQUIRE(c.add_schedule("Other", "30 * * * * ?", [](auto&) {}, second));
+
+        THEN("Each task has its own handle")
+        {
+            REQUIRE(first);
+            REQUIRE(first != duplicate);
+            REQUIRE(c.is_scheduled(first));
+            REQUIRE(c.is_scheduled(duplicate));
+            REQUIRE(c.time_until_expiry(first) == std::optional<system_clock::duration>{seconds{10}});
+            REQUIRE(c.time_until_expiry(second) == std::optional<system_clock::duration>{seconds{30}});
+        }
+        AND_WHEN("Removing a task by handle")
+        {
+            REQUIRE(c.remove_schedule(duplicate));
+
+            THEN("Only that task is removed, and only once")
+            {
+                REQUIRE(c.count() == 2);
+                REQUIRE_FALSE(c.is_scheduled(duplicate));
+                REQUIRE_FALSE(c.time_until_expiry(duplicate));
+                REQUIRE_FALSE(c.remove_schedule(duplicate));
+                REQUIRE(c.time_until_expiry(first) == std::optional<system_clock::duration>{seconds{10}});
+            }
+            AND_THEN("A new task reusing its slot does not match the old handle")
+            {
+                TaskHandle reused;
+                REQUIRE(c.add_schedule("New", "* * * * * ?", [](auto&) {}, reused));
+                REQUIRE(reused.index == duplicate.index);
+                REQUIRE(reused != duplicate);
+                REQUIRE_FALSE(c.is_scheduled(duplicate));
+                REQUIRE(c.is_scheduled(reused));
+            }
+        }
+        AND_WHEN("Clearing all tasks")
+        {
+            c.clear_schedules();
+
+            THEN("No handle refers to a task anymore")
+            {
+                REQUIRE_FALSE(c.is_scheduled(first));
+                REQUIRE_FALSE(c.is_scheduled(second));
+
+                TaskHandle next;
+                REQUIRE(c.add_schedule("Next", "* * * * * ?", [](auto&) {}, next));
+                REQUIRE_FALSE(c.is_scheduled(first));
+                REQUIRE_FALSE(c.is_scheduled(duplicate));
+                REQUIRE_FALSE(c.is_scheduled(second));
+            }
+        }
+        AND_WHEN("Removing a task by name")
+        {
+            c.remove_schedule("Other");
+
+            THEN("Its handle is no longer valid")
+            {
+                REQUIRE_FALSE(c.is_scheduled(second));
+            }
+        }
+    }
+    AND_GIVEN("An invalid schedule")
+    {
+        Cron c;
+        TaskHandle handle{};
+
+        THEN("No handle is returned")
+        {
+            REQUIRE_FALSE(c.add_schedule("Task", "invalid", [](auto&) {}, handle));
+            REQUIRE_FALSE(handle);
+        }
+    }
+}
+
+SCENARIO("Rescheduling a task")
+{
+    GIVEN("A Cron instance with a task running at second 10 of every minute")
+    {
+        auto testClock = std::make_shared<TestClock>();
+        Cron c{testClock};
+        testClock->set(sys_days{2018_y / 05 / 05});
+
+        int run_count = 0;
+        TaskHandle handle;
+        REQUIRE(c.add_schedule("Task", "10 * * * * ?", [&run_count](auto&) { ++run_count; }, handle));
+        REQUIRE(c.add_schedule("Other", "50 * * * * ?", [](auto&) {}));
+
+        WHEN("Moving it to second 5")
+        {
+            REQUIRE(c.reschedule("Task", "5 * * * * ?"));
+
+            THEN("It keeps its callback and handle and runs at the new time")
+            {
+                REQUIRE(c.count() == 2);
+                REQUIRE(c.time_until_next() == seconds{5});
+                REQUIRE(c.time_until_expiry(handle) == std::optional<system_clock::duration>{seconds{5}});
+
+                testClock->add(seconds{5});
+                REQUIRE(c.tick() == 1);
+                REQUIRE(run_count == 1);
+
+                testClock->add(seconds{5});
+                REQUIRE(c.tick() == 0);
+            }
+        }
+        AND_WHEN("Moving it right after it ran")
+        {
+            testClock->add(seconds{10});
+            REQUIRE(c.tick() == 1);
+            REQUIRE(c.reschedule("Task", "* * * * * ?"));
+
+            THEN("It does not run again within the same second")
+            {
+                REQUIRE(c.tick() == 0);
+                testClock->add(seconds{1});
+                REQUIRE(c.tick() == 1);
+                REQUIRE(run_count == 2);
+            }
+        }
+        AND_WHEN("Using an invalid schedule or an unknown name")
+        {
+            THEN("Nothing changes")
+            {
+                REQUIRE_FALSE(c.reschedule("Task", "invalid"));
+                REQUIRE_FALSE(c.reschedule("Unknown", "* * * * * ?"));
+                REQUIRE(c.count() == 2);
+                REQUIRE(c.time_until_next() == seconds{10});
+            }
+        }
+    }
+}
+
+SCENARIO("Tasks sharing a schedule")
+{
+    GIVEN("A task queue with many tasks on a few schedules")
+    {
+        TaskQueue queue;
+        const auto now = sys_days{2018_y / 05 / 05} + hours{0};
+        const auto every_second = CronSchedule::intern(*CronData::create("* * * * * ?"));
+        const auto every_ten = CronSchedule::intern(*CronData::create("*/10 * * * * ?"));
+
+        std::vector<TaskHandle> handles;
+        for (int i = 0; i < 100; ++i)
+        {
+            Task t{"Task" + std::to_string(i), i % 2 == 0 ? every_second : every_ten, [](const TaskInformation&) {}};
+            REQUIRE(t.calculate_next(now + seconds{1}));
+            handles.push_back(queue.push(std::move(t)));
+        }
+
+        THEN("Tasks are grouped by schedule and next schedule")
+        {
+            REQUIRE(queue.size() == 100);
+            REQUIRE(queue.group_count() == 2);
+            REQUIRE((queue.top().get_next_schedule() == now + seconds{1}));
+        }
+        AND_WHEN("Expiring them")
+        {
+            size_t visited = 0;
+            REQUIRE(queue.expire(now + seconds{1}, now + seconds{2}, [&visited](Task&) { ++visited; }) == 50);
+            REQUIRE(visited == 50);
+
+            THEN("Each group moves on together")
+            {
+                REQUIRE(queue.group_count() == 2);
+                REQUIRE((queue.find(handles[0])->get_next_schedule() == now + seconds{2}));
+                REQUIRE((queue.find(handles[98])->get_next_schedule() == now + seconds{2}));
+                REQUIRE((queue.find(handles[1])->get_next_schedule() == now + seconds{10}));
+            }
+            AND_THEN("Groups meeting at the same time are kept apart by schedule")
+            {
+                for (int s = 2; s <= 10; ++s)
+                {
+                    queue.expire(now + seconds{s}, now + seconds{s + 1}, [](Task&) {});
+                }
+                REQUIRE(queue.group_count() == 2);
+                REQUIRE((queue.find(handles[0])->get_next_schedule() == now + seconds{11}));
+                REQUIRE((queue.find(handles[1])->get_next_schedule() == now + seconds{20}));
+            }
+        }
+        AND_WHEN("Removing and updating single tasks")
+        {
+            REQUIRE(queue.remove(handles[0]));
+            queue.remove("Task2");
+            REQUIRE(queue.update("Task4", [&now](Task& t) { return t.calculate_next(now + seconds{5}); }));
+
+            THEN("Only those tasks leave their group")
+            {
+                REQUIRE(queue.size() == 98);
+                REQUIRE(queue.group_count() == 3);
+                REQUIRE_FALSE(queue.find(handles[0]));
+                REQUIRE((queue.find(handles[4])->get_next_schedule() == now + seconds{5}));
+                REQUIRE(queue.expire(now + seconds{1}, now + seconds{2}, [](Task&) {}) == 47);
+            }
+            AND_THEN("Recalculating merges groups that meet again")
+            {
+                queue.recalculate_all(now + seconds{10});
+                REQUIRE(queue.group_count() == 2);
+                REQUIRE((queue.find(handles[4])->get_next_schedule() == now + seconds{10}));
+            }
+        }
+    }
+    GIVEN("A Cron instance with many tasks on one schedule")
+    {
+        auto testClock = std::make_shared<TestClock>();
+        Cron c{testClock};
+        testClock->set(sys_days{2018_y / 05 / 05});
+
+        std::map<std::string, int> runs;
+        for (int i = 0; i < 20; ++i)
+        {
+            auto name = "Task" + std::to_string(i);
+            REQUIRE(c.add_schedule(name, "*/5 * * * * ?", [&runs](auto& info) { ++runs[std::string{info.get_name()}]; }));
+        }
+        REQUIRE(c.add_schedule("Other", "7 * * * * ?", [&runs](auto&) { ++runs["Other"]; }));
+
+        WHEN("Running for a minute")
+        {
+            size_t total = 0;
+            for (int s = 0; s < 60; ++s)
+            {
+                total += c.tick();
+                testClock->add(seconds{1});
+            }
+
+            THEN("Every task runs on each of its schedules")
+            {
+                REQUIRE(total == 20 * 12 + 1);
+                REQUIRE(runs.size() == 21);
+                REQUIRE(std::all_of(runs.begin(), runs.end(), [](const auto& r) { return r.first == "Other" ? r.second == 1 : r.second == 12; }));
+                REQUIRE(c.time_until_next() == seconds{0});
+            }
+        }
+    }
+    GIVEN("A Cron instance with callbacks changing tasks on their schedule")
+    {
+        auto testClock = std::make_shared<TestClock>();
+        Cron c{testClock};
+        testClock->set(sys_days{2018_y / 05 / 05});
+
+        std::map<std::string, int> runs;
+        auto count_run = [&runs](auto& info) { ++runs[std::string{info.get_name()}]; };
+
+        WHEN("A callback removes its own task and another one of its group")
+        {
+            REQUIRE(c.add_schedule("Remover", "* * * * * ?", [&](auto& info) {
+                count_run(info);
+                c.remove_schedule("Remover");
+                c.remove_schedule("Removed");
+            }));
+            REQUIRE(c.add_schedule("Removed", "* * * * * ?", count_run));
+            REQUIRE(c.add_schedule("Kept", "* * * * * ?", count_run));
+
+            for (int s = 0; s < 5; ++s)
+            {
+                c.tick();
+                testClock->add(seconds{1});
+            }
+
+            THEN("The removed tasks stop running while the others carry on")
+            {
+                REQUIRE(c.count() == 1);
+                REQUIRE(runs["Remover"] == 1);
+                REQUIRE(runs["Removed"] <= 1);
+                REQUIRE(runs["Kept"] >= 4);
+            }
+        }
+        AND_WHEN("A callback reschedules its own task")
+        {
+            REQUIRE(c.add_schedule("Rescheduled", "* * * * * ?", [&](auto& info) {
+                count_run(info);
+                c.reschedule("Rescheduled", "30 * * * * ?");
+            }));
+            REQUIRE(c.add_schedule("Other", "* * * * * ?", count_run));
+
+            for (int s = 0; s < 35; ++s)
+            {
+                c.tick();
+                testClock->add(seconds{1});
+            }
+
+            THEN("It keeps its new schedule")
+            {
+                REQUIRE(c.count() == 2);
+                REQUIRE(runs["Rescheduled"] == 2);
+                REQUIRE(runs["Other"] >= 34);
+            }
+        }
+    }
+}
+
+SCENARIO("Counting occurrences of all tasks")
+{
+    GIVEN("A Cron instance with tasks sharing and not sharing schedules")
+    {
+        Cron c;
+        REQUIRE(c.add_schedule("Every minute", "0 * * * * ?", [](auto&) {}));
+        REQUIRE(c.add_schedule("Every minute too", "0 * * * * ?", [](auto&) {}));
+        REQUIRE(c.add_schedule("Noon", "0 0 12 * * ?", [](auto&) {}));
+
+        const system_clock::time_point from = sys_days{2021_y / 3 / 1};
+        const auto until = from + days{30};
+
+        THEN("Counts are summed over all tasks")
+        {
+            REQUIRE(c.count_occurrences(from, until) == 2 * 30 * 1440 + 30);
+
+            std::vector<std::tuple<std::string, uint64_t>> counts;
+            c.get_occurrence_counts_for_tasks(from, until, counts);
+            REQUIRE(counts.size() == 3);
+            REQUIRE(std::count(counts.begin(), counts.end(), std::make_tuple(std::string{"Noon"}, uint64_t{30})) == 1);
+            REQUIRE(std::count(counts.begin(), counts.end(), std::make_tuple(std::string{"Every minute"}, uint64_t{30 * 1440})) == 1);
+        }
+    }
+}
+
+#ifndef WIN32
+SCENARIO("Local clock offset across a DST transition")
+{
+    GIVEN("The system time zone set to Central European Time")
+    {
+        const char* previous = std::getenv("TZ");
+        const std::string previous_tz = previous ? previous : "";
+        setenv("TZ", "Europe/Stockholm", 1);
+        tzset();
+
+        LocalClock clock;
+        // DST starts at 01:00 UTC on the last Sunday of March
+        const system_clock::time_point transition = sys_days{2021_y / 3 / 28} + hours{1};
+
+        THEN("The cached offset changes exactly at the transition")
+        {
+            if (clock.utc_offset(transition) == clock.utc_offset(transition - hours{2}))
+            {
+                WARN("Time zone data unavailable, skipping");
+            }
+            else
+            {
+                REQUIRE(clock.utc_offset(transition - hours{12}) == hours{1});
+                REQUIRE(clock.utc_offset(transition - seconds{1}) == hours{1});
+                REQUIRE(clock.utc_offset(transition) == hours{2});
+                REQUIRE(clock.utc_offset(transition + hours{12}) == hours{2});
+                REQUIRE(clock.utc_offset(transition - minutes{30}) == hours{1});
+                REQUIRE(clock.utc_offset(sys_days{2021_y / 10 / 31} + minutes{59}) == hours{2});
+                REQUIRE(clock.utc_offset(sys_days{2021_y / 10 / 31} + hours{1}) == hours{1});
+            }
+        }
+        AND_THEN("Copies of the clock keep working")
+        {
+            clock.utc_offset(transition - hours{12});
+            LocalClock copy{clock};
+            LocalClock assigned;
+            assigned = copy;
+
+            REQUIRE(copy.utc_offset(transition - seconds{1}) == clock.utc_offset(transition - seconds{1}));
+            REQUIRE(assigned.utc_offset(transition) == clock.utc_offset(transition));
+            REQUIRE(assigned.utc_offset(transition - hours{12}) == clock.utc_offset(transition - hours{12}));
+        }
+
+        if (previous) { setenv("TZ", previous_tz.c_str(), 1); }
+        else { unsetenv("TZ"); }
+        tzset();
+    }
+}
+#endif
+
+SCENARIO("Coarse clocks")
+{
+    GIVEN("Precise and coarse clocks")
+    {
+        UTCClock utc;
+        CoarseUTCClock coarse_utc;
+        LocalClock local;
+        CoarseLocalClock coarse_local;
+
+        THEN("They agree to well within a second")
+        {
+            auto close = [](system_clock::time_point a, system_clock::time_point b)
+            {
+                return (a > b ? a - b : b - a) < milliseconds{100};
+            };
+
+            REQUIRE(close(coarse_utc.now(), utc.now()));
+            REQUIRE(close(coarse_local.now(), local.now()));
+            REQUIRE(coarse_local.utc_offset(coarse_utc.now()) == local.utc_offset(utc.now()));
+        }
+    }
+}
+
+SCENARIO("Running callbacks on a thread pool")
+{
+    GIVEN("A Cron instance handing callbacks to a pool of two threads")
+    {
+        std::atomic<int> slow_runs{0};
+        std::atomic<int> fast_runs{0};
+        system_clock::duration slow_delay{-1s};
+        system_clock::duration fast_delay{-1s};
+        std::promise<void> release;
+        auto released = release.get_future().share();
+
+        auto clock = std::make_shared<TestClock>();
+        clock->set(sys_days{2018_y / 05 / 05});
+        auto pool = std::make_shared<ThreadPoolExecutor>(2);
+        Cron c{std::make_shared<Locker>(), clock, QueueEngineType::BinaryHeap, pool};
+
+        REQUIRE(pool->thread_count() == 2);
+        REQUIRE(c.add_schedule("Slow", "0 * * * * ?", [released, &slow_runs, &slow_delay](auto& i)
+        {
+            slow_delay = i.get_delay();
+            released.wait();
+            ++slow_runs;
+        }));
+        REQUIRE(c.add_schedule("Fast", "0 * * * * ?", [&fast_runs, &fast_delay](auto& i)
+        {
+            fast_delay = i.get_delay();
+            ++fast_runs;
+        }));
+
+        WHEN("One callback blocks")
+        {
+            clock->add(seconds{5});
+            REQUIRE(c.tick() == 2);
+
+            THEN("Other callbacks and changes to the schedule go ahead")
+            {
+                for (int i = 0; i < 500 && fast_runs == 0; ++i)
+                {
+                    std::this_thread::sleep_for(10ms);
+                }
+
+                // CHECK, so that the blocked callback is always released
+                CHECK(fast_runs == 1);
+                CHECK(slow_runs == 0);
+                CHECK(c.add_schedule("Another", "0 * * * * ?", [](auto&) {}));
+                CHECK(c.count() == 3);
+
+                release.set_value();
+                pool->wait_idle();
+
+                REQUIRE(slow_runs == 1);
+            }
+            AND_THEN("Delays are those of the dispatch")
+            {
+                release.set_value();
+                pool->wait_idle();
+
+                REQUIRE(fast_delay == 5s);
+                REQUIRE(slow_delay == 5s);
+            }
+        }
+    }
+}
+
+SCENARIO("Overlapping runs of a task")
+{
+    GIVEN("A task whose runs are dispatched but not yet run")
+    {
+        int calls = 0;
+        const auto schedule = CronSchedule::intern(*CronData::create("* * * * * ?"));
+        Task t{"Task", schedule, [&calls](auto&) { ++calls; }};
+        const system_clock::time_point start = sys_days{2018_y / 05 / 05};
+        REQUIRE(t.calculate_next(start));
+
+        auto dispatch = [&t, start](int second) { return t.dispatch(start + seconds{second}); };
+
+        WHEN("Overlaps are allowed")
+        {
+            REQUIRE(t.get_overlap_policy() == OverlapPolicy::Allow);
+            auto first = dispatch(0);
+            auto second = dispatch(1);
+
+            THEN("Each run goes ahead")
+            {
+                REQUIRE(first);
+                REQUIRE(second);
+                first->run();
+                second->run();
+                REQUIRE(calls == 2);
+            }
+        }
+        AND_WHEN("Overlapping runs are skipped")
+        {
+            t.set_overlap_policy(OverlapPolicy::Skip);
+            auto first = dispatch(0);
+
+            THEN("Runs due meanwhile are dropped")
+            {
+                REQUIRE(first);
+                REQUIRE_FALSE(dispatch(1));
+                REQUIRE_FALSE(dispatch(2));
+                first->run();
+                REQUIRE(calls == 1);
+                REQUIRE(dispatch(3));
+            }
+        }
+        AND_WHEN("Overlapping runs are coalesced")
+        {
+            t.set_overlap_policy(OverlapPolicy::Coalesce);
+            auto first = dispatch(0);
+
+            THEN("One run follows, however many were due")
+            {
+                REQUIRE(first);
+                REQUIRE_FALSE(dispatch(1));
+                REQUIRE_FALSE(dispatch(2));
+                first->run();
+                REQUIRE(calls == 2);
+                REQUIRE(dispatch(3));
+            }
+        }
+        AND_WHEN("Overlapping runs are serialized")
+        {
+            t.set_overlap_policy(OverlapPolicy::Serialize);
+            auto first = dispatch(0);
+
+            THEN("Each run due meanwhile follows in turn")
+            {
+                REQUIRE(first);
+                REQUIRE_FALSE(dispatch(1));
+                REQUIRE_FALSE(dispatch(2));
+                first->run();
+                REQUIRE(calls == 3);
+                REQUIRE(dispatch(3));
+            }
+        }
+        AND_WHEN("A run throws")
+        {
+            Task failing{"Failing", schedule, [&calls](auto&) { ++calls; throw std::runtime_error("failed"); }};
+            failing.set_overlap_policy(OverlapPolicy::Serialize);
+            REQUIRE(failing.calculate_next(start));
+            auto first = failing.dispatch(start);
+            REQUIRE_FALSE(failing.dispatch(start + 1s));
+
+            THEN("Pending runs are dropped and the task can run again")
+            {
+                REQUIRE_THROWS_AS(first->run(), std::runtime_error);
+                REQUIRE(calls == 1);
+                REQUIRE(failing.dispatch(start + 2s));
+            }
+        }
+    }
+
+    GIVEN("A Cron instance running a task every second on a work-stealing pool")
+    {
+        std::atomic<int> runs{0};
+        std::promise<void> release;
+        auto released = release.get_future().share();
+
+        auto clock = std::make_shared<TestClock>();
+        clock->set(sys_days{2018_y / 05 / 05});
+        auto pool = std::make_shared<WorkStealingExecutor>(4);
+        Cron c{std::make_shared<Locker>(), clock, QueueEngineType::BinaryHeap, pool};
+
+        REQUIRE(c.add_schedule("Slow", "* * * * * ?", [released, &runs](auto&)
+        {
+            released.wait();
+            ++runs;
+        }));
+        REQUIRE_FALSE(c.set_overlap_policy("Nothing", OverlapPolicy::Skip));
+
+        auto tick_for_five_seconds = [&c, &clock]()
+        {
+            for (int i = 0; i < 5; ++i)
+            {
+                CHECK(c.tick() == 1);
+                clock->add(seconds{1});
+            }
+        };
+
+        WHEN("Overlapping runs are coalesced")
+        {
+            REQUIRE(c.set_overlap_policy("Slow", OverlapPolicy::Coalesce));
+            tick_for_five_seconds();
+            release.set_value();
+            pool->wait_idle();
+
+            THEN("The callback runs twice")
+            {
+                REQUIRE(runs == 2);
+            }
+        }
+        AND_WHEN("Overlapping runs are serialized")
+        {
+            REQUIRE(c.set_overlap_policy("Slow", OverlapPolicy::Serialize));
+            tick_for_five_seconds();
+            release.set_value();
+            pool->wait_idle();
+
+            THEN("The callback runs for each second")
+            {
+                REQUIRE(runs == 5);
+            }
+        }
+        AND_WHEN("Overlaps are allowed")
+        {
+            tick_for_five_seconds();
+            release.set_value();
+            pool->wait_idle();
+
+            THEN("The runs are spread over the threads")
+            {
+                REQUIRE(pool->thread_count() == 4);
+                REQUIRE(runs == 5);
+            }
+        }
+    }
+}
+
+SCENARIO("Work-stealing executor")
+{
+    GIVEN("A pool of three threads")
+    {
+        auto pool = std::make_unique<WorkStealingExecutor>(3);
+        std::atomic<int> runs{0};
+        auto work = std::make_shared<const Task::TaskFunction>([&runs](auto&)
+        {
+            ++runs;
+        });
+
+        WHEN("Handing over many runs at once")
+        {
+            for (int i = 0; i < 10000; ++i)
+            {
+                pool->execute(TaskRun{std::make_shared<const std::string>("Run"), work, nullptr, 0s, system_clock::time_point::min()});
+            }
+
+            THEN("All of them run")
+            {
+                pool->wait_idle();
+                REQUIRE(runs == 10000);
+            }
+            AND_THEN("Queued runs complete before the pool is destroyed")
+            {
+                pool.reset();
+                REQUIRE(runs == 10000);
+            }
+        }
+    }
+}
+
+SCENARIO("Keyed execution lanes")
+{
+    GIVEN("A Cron instance running callbacks on two lanes")
+    {
+        auto clock = std::make_shared<TestClock>();
+        clock->set(sys_days{2018_y / 05 / 05});
+        auto lanes = std::make_shared<KeyedExecutor>(2);
+        Cron c{std::make_shared<Locker>(), clock, QueueEngineType::BinaryHeap, lanes};
+
+        // Two keys on different lanes
+        const std::string shard{"shard-1"};
+        std::string other{};
+        for (int i = 2; other.empty() || lanes->lane_of(other) == lanes->lane_of(shard); ++i)
+        {
+            other = "shard-" + std::to_string(i);
+        }
+
+        std::atomic<bool> a_running{false};
+        std::atomic<bool> b_overlapped{false};
+        std::atomic<bool> other_ran_meanwhile{false};
+        std::promise<void> other_ran;
+        auto other_done = other_ran.get_future().share();
+
+        REQUIRE(c.add_schedule("A", "0 * * * * ?", [&a_running, &other_ran_meanwhile, other_done](auto&)
+        {
+            a_running = true;
+            other_ran_meanwhile = other_done.wait_for(5s) == std::future_status::ready;
+            a_running = false;
+        }));
+        REQUIRE(c.add_schedule("B", "0 * * * * ?", [&a_running, &b_overlapped](auto&)
+        {
+            if (a_running) { b_overlapped = true; }
+        }));
+        REQUIRE(c.add_schedule("Other", "0 * * * * ?", [&other_ran](auto&)
+        {
+            other_ran.set_value();
+        }));
+
+        REQUIRE(c.set_execution_key("A", shard));
+        REQUIRE(c.set_execution_key("B", shard));
+        REQUIRE(c.set_execution_key("Other", other));
+        REQUIRE_FALSE(c.set_execution_key("Nothing", shard));
+
+        WHEN("All of them expire at once")
+        {
+            REQUIRE(c.tick() == 3);
+            lanes->wait_idle();
+
+            THEN("Tasks sharing a key run one at a time, others in parallel")
+            {
+                REQUIRE_FALSE(b_overlapped);
+                REQUIRE(other_ran_meanwhile);
+            }
+        }
+    }
+}
+
+SCENARIO("Running the scheduler on its own thread")
+{
+    GIVEN("A started Cron instance with a task far in the future")
+    {
+        std::atomic<int> runs{0};
+        Cron c{std::make_shared<Locker>()};
+        REQUIRE(c.add_schedule("Yearly", "0 0 0 1 1 ?", [](auto&) {}));
+
+        REQUIRE_FALSE(c.is_running());
+        REQUIRE(c.start());
+        REQUIRE(c.is_running());
+        REQUIRE_FALSE(c.start());
+
+        auto wait_for_runs = [&runs](int count)
+        {
+            const auto start = steady_clock::now();
+            while (runs < count && steady_clock::now() - start < 5s)
+            {
+                std::this_thread::sleep_for(10ms);
+            }
+            return steady_clock::now() - start;
+        };
+
+        WHEN("Adding a task that runs every second")
+        {
+            REQUIRE(c.add_schedule("Every second", "* * * * * ?", [&runs](auto&) { ++runs; }));
+
+            THEN("The sleeping thread is woken and runs it each second")
+            {
+                REQUIRE(wait_for_runs(3) < 3s);
+                REQUIRE(runs >= 3);
+            }
+            AND_WHEN("Removing the task")
+            {
+                wait_for_runs(1);
+                c.remove_schedule("Every second");
+                const int after_removal = runs;
+                std::this_thread::sleep_for(1500ms);
+
+                THEN("It no longer runs")
+                {
+                    REQUIRE(runs == after_removal);
+                }
+            }
+            AND_WHEN("Stopping the thread")
+            {
+                wait_for_runs(1);
+                c.stop();
+                const int after_stop = runs;
+                std::this_thread::sleep_for(1500ms);
+
+                THEN("Nothing runs any more")
+                {
+                    REQUIRE_FALSE(c.is_running());
+                    REQUIRE(runs == after_stop);
+                    REQUIRE(c.start());
+                }
+            }
+        }
+        AND_WHEN("Moving the stopped instance")
+        {
+            c.stop();
+            Cron moved{std::move(c)};
+
+            THEN("Both instances can be used")
+            {
+                REQUIRE(moved.count() == 1);
+                REQUIRE(moved.start());
+                REQUIRE(moved.is_running());
+
+                REQUIRE(c.count() == 0);
+                REQUIRE_FALSE(c.is_running());
+                REQUIRE(c.start());
+                REQUIRE(c.add_schedule("Every second", "* * * * * ?", [&runs](auto&) { ++runs; }));
+                REQUIRE(wait_for_runs(1) < 3s);
+                c.stop();
+                REQUIRE_FALSE(c.is_running());
+
+                moved = std::move(c);
+                REQUIRE_FALSE(moved.is_running());
+                REQUIRE(c.start());
+            }
+        }
+    }
+    GIVEN("A Cron instance with a task whose callback throws")
+    {
+        std::atomic<int> runs{0};
+        std::atomic<int> errors{0};
+        Cron c{std::make_shared<Locker>()};
+        REQUIRE(c.add_schedule("Throwing", "* * * * * ?", [&runs](auto&) {
+            ++runs;
+            throw std::runtime_error("failed");
+        }));
+
+        auto wait_for_runs = [&runs](int count)
+        {
+            const auto start = steady_clock::now();
+            while (runs < count && steady_clock::now() - start < 5s)
+            {
+                std::this_thread::sleep_for(10ms);
+            }
+        };
+
+        WHEN("Starting the thread with an error handler")
+        {
+            REQUIRE(c.start([&errors](std::exception_ptr e) {
+                try
+                {
+                    std::rethrow_exception(e);
+                }
+                catch (const std::runtime_error&)
+                {
+                    ++errors;
+                }
+            }));
+            wait_for_runs(2);
+            c.stop();
+
+            THEN("The exceptions are passed to it and the task keeps running")
+            {
+                REQUIRE(runs >= 2);
+                REQUIRE(errors == runs);
+            }
+        }
+        AND_WHEN("Starting the thread without one")
+        {
+            REQUIRE(c.start());
+            wait_for_runs(2);
+            c.stop();
+
+            THEN("The exceptions are dropped and the task keeps running")
+            {
+                REQUIRE(runs >= 2);
+            }
+        }
+    }
+}
+
+#ifdef __linux__
+SCENARIO("Waiting for tasks with a timer file descriptor")
+{
+    GIVEN("A Cron instance without tasks")
+    {
+        std::atomic<int> runs{0};
+        Cron c{std::make_shared<Locker>()};
+
+        const int fd = c.get_timer_fd();
+        REQUIRE(fd >= 0);
+        REQUIRE(c.get_timer_fd() == fd);
+
+        auto readable = [fd](milliseconds timeout)
+        {
+            pollfd p{fd, POLLIN, 0};
+            return poll(&p, 1, static_cast<int>(timeout.count())) == 1;
+        };
+
+        THEN("The descriptor does not become readable")
+        {
+            REQUIRE_FALSE(readable(1500ms));
+        }
+        AND_WHEN("Adding a task far in the future")
+        {
+            REQUIRE(c.add_schedule("Yearly", "0 0 0 1 1 ?", [](auto&) {}));
+
+            THEN("The timer is armed at most a day ahead")
+            {
+                itimerspec spec{};
+                REQUIRE(timerfd_gettime(fd, &spec) == 0);
+                REQUIRE(spec.it_value.tv_sec > 0);
+                REQUIRE(spec.it_value.tv_sec <= 24 * 60 * 60);
+            }
+        }
+
+        WHEN("Adding a task that runs every second")
+        {
+            REQUIRE(c.add_schedule("Every second", "* * * * * ?", [&runs](auto&) { ++runs; }));
+
+            THEN("The descriptor becomes readable when it is due")
+            {
+                REQUIRE(readable(2s));
+                REQUIRE(c.tick() == 1);
+                REQUIRE(runs == 1);
+
+                AND_THEN("Ticking arms it for the next run")
+                {
+                    REQUIRE_FALSE(readable(0ms));
+                    REQUIRE(readable(1500ms));
+                    REQUIRE(c.tick() == 1);
+                    REQUIRE(runs == 2);
+                }
+            }
+            AND_WHEN("Removing the task")
+            {
+                c.clear_schedules();
+
+                THEN("The descriptor no longer becomes readable")
+                {
+                    REQUIRE_FALSE(readable(1500ms));
+                }
+            }
+        }
+    }
+}
+#endif
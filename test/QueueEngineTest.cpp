@@ -0,0 +1,199 @@
+#include <date/date.h>
+#include <libcron/include/libcron/HeapEngine.h>
+#include <libcron/include/libcron/TimingWheelEngine.h>
+#include <catch.hpp>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <random>
+#include <set>
+
+using namespace libcron;
+using namespace date;
+using namespace std::chrono;
+
+namespace
+{
+// A random time relative to now, spread over every level of the timing wheel,
+//  the overflow list and the past.
+system_clock::time_point random_due(std::mt19937& rng, system_clock::time_point now)
+{
+  const auto pick = std::uniform_int_distribution<int>{0, 99}(rng);
+
+  if (pick < 40) { return now + seconds{std::uniform_int_distribution<int>{1, 90}(rng)}; }
+  if (pick < 60) { return now + seconds{std::uniform_int_distribution<int>{1, 4 * 3600}(rng)}; }
+  if (pick < 75) { return now + seconds{std::uniform_int_distribution<int>{1, 3 * 86400}(rng)}; }
+  if (pick < 85) { return now + hours{std::uniform_int_distribution<int>{1, 3 * 366 * 24}(rng)}; }
+  if (pick < 90) { return now + milliseconds{std::uniform_int_distribution<int>{1, 5000}(rng)}; }
+  if (pick < 95) { return now - seconds{std::uniform_int_distribution<int>{0, 600}(rng)}; }
+  return system_clock::time_point::max();
+}
+
+system_clock::duration random_step(std::mt19937& rng)
+{
+  const auto pick = std::uniform_int_distribution<int>{0, 99}(rng);
+
+  if (pick < 70) { return seconds{1}; }
+  if (pick < 80) { return milliseconds{std::uniform_int_distribution<int>{1, 999}(rng)}; }
+  if (pick < 90) { return seconds{std::uniform_int_distribution<int>{2, 3 * 3600}(rng)}; }
+  if (pick < 95) { return hours{std::uniform_int_distribution<int>{3, 24 * 40}(rng)}; }
+  return -seconds{std::uniform_int_distribution<int>{1, 2 * 3600}(rng)};
+}
+
+// Runs a random sequence of operations against the engine and a plain map of
+//  slot -> due time, checking that both agree on what is due and what is next.
+bool matches_model(IQueueEngine& engine, unsigned seed)
+{
+  std::mt19937                                 rng{seed};
+  std::map<size_t, system_clock::time_point>   model;
+  std::vector<size_t>                          free_slots;
+  size_t                                       slot_count = 0;
+  system_clock::time_point                     now = sys_days{2021_y / 12 / 31} + hours{23} + minutes{59};
+
+  for (int step = 0; step < 3000; ++step)
+  {
+    const auto op = std::uniform_int_distribution<int>{0, 9}(rng);
+
+    if (op < 4 || model.empty())
+    {
+      size_t slot = slot_count;
+      if (!free_slots.empty())
+      {
+        slot = free_slots.back();
+        free_slots.pop_back();
+      }
+      else { ++slot_count; }
+
+      model[slot] = random_due(rng, now);
+      engine.insert(slot, model[slot]);
+    }
+    else if (op < 6)
+    {
+      auto it = std::next(model.begin(),
+                          std::uniform_int_distribution<long>{0, static_cast<long>(model.size()) - 1}(rng));
+      if (op == 4)
+      {
+        engine.erase(it->first);
+        free_slots.push_back(it->first);
+        model.erase(it);
+      }
+      else
+      {
+        it->second = random_due(rng, now);
+        engine.update(it->first, it->second);
+      }
+    }
+    else { now += random_step(rng); }
+
+    // Everything the engine reports as due must be due, and everything due
+    //  must be reported. Due slots are rescheduled into the future or dropped.
+    std::set<size_t> expected;
+    for (const auto& entry : model)
+    {
+      if (entry.second <= now) { expected.insert(entry.first); }
+    }
+
+    std::set<size_t> reported;
+    for (auto slot = engine.next_due(now); slot != IQueueEngine::npos; slot = engine.next_due(now))
+    {
+      if (expected.count(slot) == 0 || !reported.insert(slot).second) { return false; }
+
+      if (std::uniform_int_distribution<int>{0, 3}(rng) == 0)
+      {
+        engine.erase(slot);
+        free_slots.push_back(slot);
+        model.erase(slot);
+      }
+      else
+      {
+        model[slot] = now + seconds{std::uniform_int_distribution<int>{1, 7200}(rng)};
+        engine.update(slot, model[slot]);
+      }
+    }
+
+    if (reported != expected) { return false; }
+
+    const auto first = engine.earliest();
+    if (model.empty() != (first == IQueueEngine::npos)) { return false; }
+
+    if (first != IQueueEngine::npos)
+    {
+      auto earliest_due = system_clock::time_point::max();
+      for (const auto& entry : model) { earliest_due = std::min(earliest_due, entry.second); }
+
+      if (model.count(first) == 0 || model[first] != earliest_due) { return false; }
+    }
+  }
+
+  return true;
+}
+}  // namespace
+
+SCENARIO("Queue engines agree with a reference model")
+{
+  GIVEN("Random inserts, updates, removals and clock steps")
+  {
+    THEN("The binary heap reports exactly the due slots")
+    {
+      for (unsigned seed = 1; seed <= 20; ++seed)
+      {
+        HeapEngine engine;
+        INFO("seed " << seed);
+        REQUIRE(matches_model(engine, seed));
+      }
+    }
+    AND_THEN("The timing wheel reports exactly the due slots")
+    {
+      for (unsigned seed = 1; seed <= 20; ++seed)
+      {
+        TimingWheelEngine engine;
+        INFO("seed " << seed);
+        REQUIRE(matches_model(engine, seed));
+      }
+    }
+  }
+}
+
+SCENARIO("Timing wheel cascades")
+{
+  GIVEN("A timing wheel with slots due on every level")
+  {
+    TimingWheelEngine engine;
+    const system_clock::time_point start = sys_days{2022_y / 2 / 27} + hours{23} + minutes{58} + seconds{30};
+
+    // The first insert puts the cursor far ahead, so the first lookup has to
+    //  rewind the wheel
+    engine.insert(4, start + days{700});
+    engine.insert(3, start + days{2} + hours{5});
+    engine.insert(2, start + hours{1} + minutes{30});
+    engine.insert(1, start + minutes{3});
+    engine.insert(0, start + seconds{10});
+
+    WHEN("Stepping one second at a time")
+    {
+      std::vector<std::pair<size_t, system_clock::time_point>> fired;
+      auto now = start - days{1};
+
+      REQUIRE(engine.next_due(now) == IQueueEngine::npos);
+
+      for (now = start; now <= start + days{3}; now += seconds{1})
+      {
+        for (auto slot = engine.next_due(now); slot != IQueueEngine::npos; slot = engine.next_due(now))
+        {
+          fired.emplace_back(slot, now);
+          engine.erase(slot);
+        }
+      }
+
+      THEN("Each slot fires exactly at its due time")
+      {
+        REQUIRE(fired.size() == 4);
+        REQUIRE((fired[0] == std::make_pair(size_t{0}, start + seconds{10})));
+        REQUIRE((fired[1] == std::make_pair(size_t{1}, start + minutes{3})));
+        REQUIRE((fired[2] == std::make_pair(size_t{2}, start + hours{1} + minutes{30})));
+        REQUIRE((fired[3] == std::make_pair(size_t{3}, start + days{2} + hours{5})));
+        REQUIRE(engine.earliest() == 4);
+      }
+    }
+  }
+}
@@ -0,0 +1,264 @@
+#include <date/date.h>
+#include <libcron/include/libcron/Cron.h>
+#include <libcron/include/libcron/TimeZone.h>
+#include <catch.hpp>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace libcron;
+using namespace date;
+using namespace std::chrono;
+
+namespace
+{
+// Central European Time during 2021, with DST from March 28th to October 31st
+std::shared_ptr<const TimeZone> central_europe()
+{
+  return std::make_shared<const TimeZone>(
+    "CET",
+    std::vector<TimeZoneTransition>{
+      {sys_days{1970_y / 1 / 1}, hours{1}},
+      {sys_days{2021_y / 3 / 28} + hours{1}, hours{2}},
+      {sys_days{2021_y / 10 / 31} + hours{1}, hours{1}}});
+}
+
+system_clock::time_point utc(year_month_day ymd,
+                             hours          h = hours{0},
+                             minutes        m = minutes{0},
+                             seconds        s = seconds{0})
+{
+  return sys_days{ymd} + h + m + s;
+}
+
+system_clock::time_point next(const TimeZone& zone, const char* expression, system_clock::time_point from)
+{
+  auto c{CronData::create(expression)};
+  REQUIRE(c.has_value());
+  const auto res = zone.calculate_from(CronSchedule{*c}, from);
+  REQUIRE(std::get<0>(res));
+  return std::get<1>(res);
+}
+
+// the number of runs within [from, until), one occurrence after the other
+uint64_t runs_between(const TimeZone& zone, const char* expression, system_clock::time_point from, system_clock::time_point until)
+{
+  auto c{CronData::create(expression)};
+  REQUIRE(c.has_value());
+  const CronSchedule sched{*c};
+
+  uint64_t res = 0;
+  for (auto next = zone.calculate_from(sched, from); std::get<0>(next) && std::get<1>(next) < until;
+       next      = zone.calculate_from(sched, std::get<1>(next) + seconds{1}))
+  {
+    ++res;
+  }
+  return res;
+}
+
+uint64_t count_between(const TimeZone& zone, const char* expression, system_clock::time_point from, system_clock::time_point until)
+{
+  auto c{CronData::create(expression)};
+  REQUIRE(c.has_value());
+  return zone.count_between(CronSchedule{*c}, from, until);
+}
+
+class ManualClock : public ICronClock
+{
+public:
+  std::chrono::system_clock::time_point now() const override { return current; }
+
+  std::chrono::seconds utc_offset(std::chrono::system_clock::time_point) const override
+  {
+    return seconds{0};
+  }
+
+  system_clock::time_point current{};
+};
+}  // namespace
+
+SCENARIO("Schedules in a time zone")
+{
+  GIVEN("A time zone with DST")
+  {
+    const auto zone = central_europe();
+
+    THEN("Offsets change at the transitions")
+    {
+      REQUIRE(zone->utc_offset(utc(2021_y / 3 / 28, hours{1}) - seconds{1}) == hours{1});
+      REQUIRE(zone->utc_offset(utc(2021_y / 3 / 28, hours{1})) == hours{2});
+      REQUIRE((zone->to_local(utc(2021_y / 7 / 1, hours{10})) == utc(2021_y / 7 / 1, hours{12})));
+    }
+    AND_THEN("Schedules are matched against civil time")
+    {
+      REQUIRE((next(*zone, "0 0 9 * * ?", utc(2021_y / 1 / 15)) == utc(2021_y / 1 / 15, hours{8})));
+      REQUIRE((next(*zone, "0 0 9 * * ?", utc(2021_y / 7 / 15)) == utc(2021_y / 7 / 15, hours{7})));
+    }
+    AND_THEN("An occurrence in the gap runs at the transition, once")
+    {
+      const auto transition = utc(2021_y / 3 / 28, hours{1});
+      REQUIRE((next(*zone, "0 30 2 * * ?", utc(2021_y / 3 / 27, hours{12})) == transition));
+      REQUIRE((next(*zone, "0 30 2 * * ?", transition + seconds{1}) == utc(2021_y / 3 / 29, hours{0}, minutes{30})));
+
+      REQUIRE((next(*zone, "0 * * * * ?", utc(2021_y / 3 / 28, hours{0}, minutes{58}, seconds{1})) == transition - minutes{1}));
+      REQUIRE((next(*zone, "0 * * * * ?", transition - seconds{59}) == transition));
+      REQUIRE((next(*zone, "0 * * * * ?", transition + seconds{1}) == transition + minutes{1}));
+
+      // Still due right at the transition, also after a run just before it
+      REQUIRE((next(*zone, "59 59 * * * ?", transition) == transition));
+    }
+    AND_THEN("An occurrence in the overlap runs during the first pass only")
+    {
+      const auto first_pass = utc(2021_y / 10 / 31, hours{0}, minutes{30});
+      REQUIRE((next(*zone, "0 30 2 * * ?", utc(2021_y / 10 / 30, hours{12})) == first_pass));
+      REQUIRE((next(*zone, "0 30 2 * * ?", first_pass + seconds{1}) == utc(2021_y / 11 / 1, hours{1}, minutes{30})));
+
+      // Also when scheduling starts during the second pass
+      REQUIRE((next(*zone, "0 30 2 * * ?", utc(2021_y / 10 / 31, hours{1}, minutes{10})) == utc(2021_y / 11 / 1, hours{1}, minutes{30})));
+    }
+    AND_THEN("The repeated civil time is not searched again during the second pass")
+    {
+      const auto transition = utc(2021_y / 10 / 31, hours{1});
+      REQUIRE((next(*zone, "59 59 * * * ?", transition - seconds{1}) == transition - seconds{1}));
+      REQUIRE((next(*zone, "59 59 * * * ?", transition) == transition + hours{1} + seconds{3599}));
+
+      REQUIRE((next(*zone, "* * * * * ?", transition - seconds{1}) == transition - seconds{1}));
+      REQUIRE((next(*zone, "* * * * * ?", transition) == transition + hours{1}));
+      REQUIRE((next(*zone, "* * * * * ?", transition + minutes{30}) == transition + hours{1}));
+    }
+    AND_THEN("Previous occurrences follow the same rules")
+    {
+      auto c{CronData::create("0 30 2 * * ?")};
+      REQUIRE(c.has_value());
+      CronSchedule sched{*c};
+
+      const auto overlap = zone->calculate_before(sched, utc(2021_y / 10 / 31, hours{2}));
+      REQUIRE(std::get<0>(overlap));
+      REQUIRE((std::get<1>(overlap) == utc(2021_y / 10 / 31, hours{0}, minutes{30})));
+
+      const auto gap = zone->calculate_before(sched, utc(2021_y / 3 / 28, hours{2}));
+      REQUIRE(std::get<0>(gap));
+      REQUIRE((std::get<1>(gap) == utc(2021_y / 3 / 28, hours{1})));
+    }
+    AND_THEN("Occurrences are counted as they run")
+    {
+      const auto spring = utc(2021_y / 3 / 28, hours{1});
+      const auto fall   = utc(2021_y / 10 / 31, hours{1});
+
+      // The gap collapses into one run at the transition, the overlap runs once
+      REQUIRE(count_between(*zone, "0 * * * * ?", spring - hours{1}, spring + hours{2}) == 180);
+      REQUIRE(count_between(*zone, "0 * * * * ?", fall - hours{1}, fall + hours{2}) == 120);
+
+      for (const auto* expression : {"0 * * * * ?", "* * * * * ?", "59 59 * * * ?", "0 30 2 * * ?", "0 0 3 * * ?", "0 */7 2 * * ?"})
+      {
+        for (const auto& [from, until] : {std::make_pair(spring - hours{2}, spring + hours{2}),
+                                          std::make_pair(spring, spring + hours{1}),
+                                          std::make_pair(fall - hours{2}, fall + hours{2}),
+                                          std::make_pair(fall + minutes{30}, fall + hours{2}),
+                                          std::make_pair(fall - seconds{1}, fall + seconds{1})})
+        {
+          INFO(expression);
+          REQUIRE(count_between(*zone, expression, from, until) == runs_between(*zone, expression, from, until));
+        }
+      }
+
+      // A range spanning both transitions
+      const auto from  = utc(2021_y / 3 / 1);
+      const auto until = utc(2021_y / 12 / 1);
+      for (const auto* expression : {"0 30 2 * * ?", "59 59 * * * ?", "0 */10 * * * ?", "0 0 2,3 ? * SUN"})
+      {
+        INFO(expression);
+        REQUIRE(count_between(*zone, expression, from, until) == runs_between(*zone, expression, from, until));
+      }
+      // Once a day, also on the days of the transitions
+      REQUIRE(count_between(*zone, "0 30 2 * * ?", from, until) == 275);
+    }
+  }
+
+  GIVEN("A Cron instance with tasks in different time zones")
+  {
+    auto clock = std::make_shared<ManualClock>();
+    clock->current = utc(2021_y / 7 / 15);
+    Cron c{clock};
+
+    const auto new_york = std::make_shared<const TimeZone>(
+      "EDT", std::vector<TimeZoneTransition>{{sys_days{1970_y / 1 / 1}, -hours{4}}});
+
+    std::vector<std::string> runs;
+    REQUIRE(c.add_schedule("Stockholm", "0 0 9 * * ?", central_europe(), [&runs](auto& i) { runs.push_back(i.get_name()); }));
+    REQUIRE(c.add_schedule("New York", "0 0 9 * * ?", new_york, [&runs](auto& i) { runs.push_back(i.get_name()); }));
+    REQUIRE(c.add_schedule("UTC", "0 0 9 * * ?", [&runs](auto& i) { runs.push_back(i.get_name()); }));
+    REQUIRE_FALSE(c.add_schedule("Nowhere", "0 0 9 * * ?", nullptr, [](auto&) {}));
+
+    THEN("They share one queue ordered in UTC")
+    {
+      REQUIRE(c.count() == 3);
+      REQUIRE(c.time_until_next() == hours{7});
+
+      for (int h = 0; h < 24; ++h)
+      {
+        clock->current = utc(2021_y / 7 / 15, hours{h});
+        c.tick();
+      }
+
+      REQUIRE(runs == std::vector<std::string>{"Stockholm", "UTC", "New York"});
+    }
+    AND_THEN("Occurrences are counted in civil time")
+    {
+      REQUIRE(c.count_occurrences(utc(2021_y / 7 / 1), utc(2021_y / 7 / 31)) == 90);
+    }
+  }
+
+  GIVEN("A Cron instance with a task in a time zone leaving DST")
+  {
+    const auto transition = utc(2021_y / 10 / 31, hours{1});
+
+    auto clock = std::make_shared<ManualClock>();
+    clock->current = transition - hours{1};
+    Cron c{clock};
+
+    int runs = 0;
+    REQUIRE(c.add_schedule("Stockholm", "0 * * * * ?", central_europe(), [&runs](auto&) { ++runs; }));
+
+    THEN("The repeated hour runs once")
+    {
+      for (; clock->current < transition + hours{2}; clock->current += seconds{1})
+      {
+        c.tick();
+      }
+
+      REQUIRE(runs == 120);
+    }
+    AND_THEN("As many occurrences are counted as run")
+    {
+      REQUIRE(c.count_occurrences(transition - hours{1}, transition + hours{2}) == 120);
+      // The skipped hour and the start of the next collapse into one run
+      REQUIRE(c.count_occurrences(utc(2021_y / 3 / 1), utc(2021_y / 12 / 1)) == 275 * 1440 - 60);
+    }
+  }
+
+  GIVEN("Time zones looked up by name")
+  {
+    THEN("Unknown zones are not found")
+    {
+      REQUIRE_FALSE(TimeZone::locate("Nowhere/Nothing"));
+    }
+
+    auto stockholm = TimeZone::locate("Europe/Stockholm");
+    if (!stockholm)
+    {
+      WARN("Built without time zone support");
+    }
+    else
+    {
+      THEN("The transition table matches the time zone database")
+      {
+        REQUIRE(stockholm == TimeZone::locate("Europe/Stockholm"));
+        REQUIRE(stockholm->utc_offset(utc(2021_y / 3 / 28, hours{1}) - seconds{1}) == hours{1});
+        REQUIRE(stockholm->utc_offset(utc(2021_y / 3 / 28, hours{1})) == hours{2});
+        REQUIRE(stockholm->utc_offset(utc(2021_y / 10 / 31, hours{1})) == hours{1});
+      }
+    }
+  }
+}